@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "Assignment.h"
+
+/*
+ * Shortest augmenting paths over reduced costs (the Hungarian method in its Jonker-Volgenant form).
+ * Rows are the nodes still to be left, columns the nodes still to be entered, both indexed by node.
+ * A block is always optimal for its own path length, so the duals keep every reduced cost of an existing
+ * edge between active rows and columns non-negative and those of the assigned pairs at zero.
+ */
+
+#define BITS_PER_WORD 32
+#define UNREACHED LLONG_MAX
+
+struct AssignmentWork {
+    int *rowOf;
+    int *previousRow;
+    bool *scanned;
+    long long *distance;
+};
+
+AssignmentWork *assignment_create_work(int n) {
+    AssignmentWork *work = malloc(sizeof(AssignmentWork));
+    work->rowOf = malloc(n * sizeof(int));
+    work->previousRow = malloc(n * sizeof(int));
+    work->scanned = malloc(n * sizeof(bool));
+    work->distance = malloc(n * sizeof(long long));
+    return work;
+}
+
+void assignment_free_work(AssignmentWork *work) {
+    if (work == NULL) return;
+    free(work->rowOf);
+    free(work->previousRow);
+    free(work->scanned);
+    free(work->distance);
+    free(work);
+}
+
+static bool is_visited(const int *visited, int node) {
+    return ((unsigned int) visited[node / BITS_PER_WORD] >> (node % BITS_PER_WORD)) & 1u;
+}
+
+// the last node and the unvisited ones still have to be left, 0 and the unvisited ones entered
+static bool is_active_row(const int *visited, int last, int row) {
+    return row == last || !is_visited(visited, row);
+}
+
+static bool is_active_column(const int *visited, int column) {
+    return column == 0 || !is_visited(visited, column);
+}
+
+/*
+ * Dijkstra from the free row start over the reduced costs to the nearest free column, then shifts the duals of
+ * the scanned columns and their rows by how much closer they were, which keeps them feasible and makes the path
+ * tight, and flips the assignment along it. False if no free column is reachable over existing edges.
+ */
+static bool augment(const int *edgeMatrix, int n, const int *visited, int start, int *block, AssignmentWork *work) {
+    int *rowDual = &block[ASSIGNMENT_DUALS];
+    int *colDual = &rowDual[n];
+    int *columnOf = &colDual[n];
+    for (int column = 0; column < n; column++) {
+        work->distance[column] = UNREACHED;
+        work->scanned[column] = !is_active_column(visited, column);
+    }
+    int row = start;
+    long long base = 0;
+    int end;
+    while (true) {
+        for (int column = 0; column < n; column++) {
+            int dist = edgeMatrix[row * n + column];
+            if (work->scanned[column] || dist == 0 || column == row) continue;
+            long long reduced = base + dist - rowDual[row] - colDual[column];
+            if (reduced < work->distance[column]) {
+                work->distance[column] = reduced;
+                work->previousRow[column] = row;
+            }
+        }
+        int next = -1;
+        for (int column = 0; column < n; column++) {
+            if (work->scanned[column] || work->distance[column] == UNREACHED) continue;
+            if (next < 0 || work->distance[column] < work->distance[next]) next = column;
+        }
+        if (next < 0) return false;
+        work->scanned[next] = true;
+        if (work->rowOf[next] < 0) {
+            end = next;
+            break;
+        }
+        row = work->rowOf[next];
+        base = work->distance[next];
+    }
+    long long length = work->distance[end];
+    for (int column = 0; column < n; column++) {
+        // inactive columns start out scanned but are never reached
+        if (!work->scanned[column] || work->distance[column] == UNREACHED) continue;
+        int shift = (int) (length - work->distance[column]);
+        colDual[column] -= shift;
+        if (work->rowOf[column] >= 0) rowDual[work->rowOf[column]] += shift;
+    }
+    rowDual[start] += (int) length;
+    for (int column = end; ; ) {
+        int previous = work->previousRow[column];
+        int freed = columnOf[previous];
+        columnOf[previous] = column;
+        work->rowOf[column] = previous;
+        if (previous == start) break;
+        column = freed;
+    }
+    return true;
+}
+
+static bool solve_from_scratch(const int *edgeMatrix, int n, int last, const int *visited, int *block,
+                               AssignmentWork *work) {
+    int *rowDual = &block[ASSIGNMENT_DUALS];
+    int *colDual = &rowDual[n];
+    int *columnOf = &colDual[n];
+    for (int node = 0; node < n; node++) {
+        rowDual[node] = 0;
+        colDual[node] = 0;
+        columnOf[node] = -1;
+        work->rowOf[node] = -1;
+    }
+    for (int row = 0; row < n; row++) {
+        if (!is_active_row(visited, last, row)) continue;
+        if (!augment(edgeMatrix, n, visited, row, block, work)) return false;
+    }
+    return true;
+}
+
+/*
+ * Brings block up to the path of the given length: nothing to do if it is already solved for it, one augmenting
+ * path if it was solved for the path without its last node, and a solve from scratch otherwise.
+ * Returns whether the remaining nodes can still be assigned at all, the cost is INT_MAX if not.
+ */
+bool assignment_refresh(const int *edgeMatrix, int n, const int *path, int length, const int *visited, int *block,
+                        AssignmentWork *work) {
+    if (block[ASSIGNMENT_LENGTH] == length) return block[ASSIGNMENT_COST] != INT_MAX;
+    int *rowDual = &block[ASSIGNMENT_DUALS];
+    int *colDual = &rowDual[n];
+    int *columnOf = &colDual[n];
+    int last = path[length - 1];
+    bool solved;
+    if (block[ASSIGNMENT_LENGTH] == length - 1 && block[ASSIGNMENT_COST] != INT_MAX) {
+        for (int node = 0; node < n; node++) work->rowOf[node] = -1;
+        for (int row = 0; row < n; row++) {
+            if (columnOf[row] >= 0) work->rowOf[columnOf[row]] = row;
+        }
+        // the previous node's row and the last node's column leave, whoever entered last is reassigned
+        int previous = path[length - 2];
+        int freedColumn = columnOf[previous];
+        int freedRow = work->rowOf[last];
+        columnOf[previous] = -1;
+        work->rowOf[freedColumn] = -1;
+        solved = true;
+        if (freedColumn != last) {
+            columnOf[freedRow] = -1;
+            work->rowOf[last] = -1;
+            solved = augment(edgeMatrix, n, visited, freedRow, block, work);
+        }
+    } else {
+        solved = solve_from_scratch(edgeMatrix, n, last, visited, block, work);
+    }
+    block[ASSIGNMENT_LENGTH] = length;
+    block[ASSIGNMENT_COST] = INT_MAX;
+    if (!solved) return false;
+    long cost = 0;
+    for (int row = 0; row < n; row++) {
+        if (is_active_row(visited, last, row)) cost += edgeMatrix[row * n + columnOf[row]];
+    }
+    if (cost < INT_MAX) block[ASSIGNMENT_COST] = (int) cost;
+    return block[ASSIGNMENT_COST] != INT_MAX;
+}
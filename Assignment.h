@@ -0,0 +1,44 @@
+#ifndef TRAVELINGSALESMAN_ASSIGNMENT_H
+#define TRAVELINGSALESMAN_ASSIGNMENT_H
+
+#include <stdbool.h>
+#include <limits.h>
+
+/*
+ * Assignment bound of a path 0 -> ... -> last: every tour through it leaves last and each unvisited node once
+ * and enters each unvisited node and 0 once, so the cheapest assignment of these rows to these columns over the
+ * existing edges, subtours allowed, never overestimates the rest of the tour. On asymmetric instances it is far
+ * tighter than the cheapest out-edges.
+ * A block holds the path length it was solved for, the assignment cost (INT_MAX if there is none), the row and
+ * column duals and the column of every row. Appending a node deletes one row and one column, which leaves at most
+ * one row to reassign, so the block of a child is one shortest augmenting path away from its parent's.
+ */
+
+#define ASSIGNMENT_LENGTH 0
+#define ASSIGNMENT_COST 1
+#define ASSIGNMENT_DUALS 2
+
+typedef struct AssignmentWork AssignmentWork;
+
+AssignmentWork *assignment_create_work(int n);
+void assignment_free_work(AssignmentWork *work);
+bool assignment_refresh(const int *edgeMatrix, int n, const int *path, int length, const int *visited, int *block,
+                        AssignmentWork *work);
+
+static inline int get_assignment_size(int n) {
+    return ASSIGNMENT_DUALS + 3 * n;
+}
+
+/*
+ * Lower bound of every tour through the path appended by i over an edge of length dist, from the block of the
+ * path: the duals stay feasible without the row of last and the column of i, so the child's assignment costs at
+ * least the parent's minus both duals.
+ */
+static inline long get_assignment_child_bound(const int *block, int n, int pathDist, int last, int i, int dist) {
+    if (block[ASSIGNMENT_COST] == INT_MAX) return LONG_MAX;
+    const int *rowDual = &block[ASSIGNMENT_DUALS];
+    const int *colDual = &rowDual[n];
+    return (long) pathDist + block[ASSIGNMENT_COST] + dist - rowDual[last] - colDual[i];
+}
+
+#endif //TRAVELINGSALESMAN_ASSIGNMENT_H
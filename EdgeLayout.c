@@ -0,0 +1,343 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "EdgeLayout.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ROW_KERNELS_X86
+#endif
+
+/*
+ * The automatic choice switches to CSR once at most SPARSE_MAX_DENSITY of all edges exist:
+ * expansion then walks the real out-neighbours instead of testing every unvisited node.
+ * Denser matrices are narrowed to the smallest integer type holding the largest weight,
+ * so that even a few hundred nodes keep the matrix in L1/L2.
+ */
+#define SPARSE_MAX_DENSITY 0.3
+// get_row_candidates works on the 32-node words of the visited bitsets
+#define ROW_WORD_BITS 32
+
+bool parse_edge_layout(const char *arg, enum EdgeLayoutKind *kind) {
+    if (strcmp(arg, "auto") == 0) {
+        *kind = LAYOUT_AUTO;
+    } else if (strcmp(arg, "dense") == 0) {
+        *kind = LAYOUT_DENSE;
+    } else if (strcmp(arg, "dense16") == 0) {
+        *kind = LAYOUT_DENSE16;
+    } else if (strcmp(arg, "dense8") == 0) {
+        *kind = LAYOUT_DENSE8;
+    } else if (strcmp(arg, "sparse") == 0) {
+        *kind = LAYOUT_SPARSE;
+    } else {
+        printf("Unknown edge layout '%s'!\n", arg);
+        return false;
+    }
+    return true;
+}
+
+const char *get_edge_layout_name(enum EdgeLayoutKind kind) {
+    switch (kind) {
+        case LAYOUT_DENSE8:
+            return "dense8";
+        case LAYOUT_DENSE16:
+            return "dense16";
+        case LAYOUT_SPARSE:
+            return "sparse";
+        case LAYOUT_DENSE:
+            return "dense";
+        default:
+            return "auto";
+    }
+}
+
+static enum EdgeLayoutKind choose_layout(const int *edgeMatrix, int n) {
+    long long edges = 0;
+    int maxWeight = 0;
+    for (int row = 0; row < n; row++) {
+        for (int col = 0; col < n; col++) {
+            int dist = edgeMatrix[row * n + col];
+            if (row == col || dist == 0) continue;
+            edges++;
+            if (dist > maxWeight) maxWeight = dist;
+        }
+    }
+    if (edges <= SPARSE_MAX_DENSITY * n * (n - 1)) return LAYOUT_SPARSE;
+    if (maxWeight <= UINT8_MAX) return LAYOUT_DENSE8;
+    if (maxWeight <= UINT16_MAX) return LAYOUT_DENSE16;
+    return LAYOUT_DENSE;
+}
+
+static bool fits_weights(const int *edgeMatrix, int n, int maxWeight) {
+    for (int row = 0; row < n; row++) {
+        for (int col = 0; col < n; col++) {
+            int dist = edgeMatrix[row * n + col];
+            if (row != col && (dist < 0 || dist > maxWeight)) return false;
+        }
+    }
+    return true;
+}
+
+static void build_csr(EdgeLayout *layout, const int *edgeMatrix, int n) {
+    layout->rowStart = malloc((n + 1) * sizeof(int));
+    int edges = 0;
+    for (int row = 0; row < n; row++) {
+        layout->rowStart[row] = edges;
+        for (int col = 0; col < n; col++) {
+            if (row != col && edgeMatrix[row * n + col] != 0) edges++;
+        }
+    }
+    layout->rowStart[n] = edges;
+    layout->neighbours = malloc(edges * sizeof(int));
+    layout->weights = malloc(edges * sizeof(int));
+    int e = 0;
+    for (int row = 0; row < n; row++) {
+        for (int col = 0; col < n; col++) {
+            int dist = edgeMatrix[row * n + col];
+            if (row == col || dist == 0) continue;
+            layout->neighbours[e] = col;
+            layout->weights[e] = dist;
+            e++;
+        }
+    }
+}
+
+typedef struct {
+    int weight;
+    int node;
+} WeightedNeighbour;
+
+static int compare_by_weight(const void *a, const void *b) {
+    const WeightedNeighbour *x = a, *y = b;
+    if (x->weight != y->weight) return x->weight < y->weight ? -1 : 1;
+    return x->node < y->node ? -1 : x->node > y->node;
+}
+
+// out-edges of every node in CSR form, ascending by weight and then by target node
+static void build_by_weight(EdgeLayout *layout, const int *edgeMatrix, int n) {
+    layout->byWeightStart = malloc((n + 1) * sizeof(int));
+    int edges = 0;
+    for (int row = 0; row < n; row++) {
+        layout->byWeightStart[row] = edges;
+        for (int col = 0; col < n; col++) {
+            if (row != col && edgeMatrix[row * n + col] != 0) edges++;
+        }
+    }
+    layout->byWeightStart[n] = edges;
+    layout->byWeightNeighbours = malloc(edges * sizeof(int));
+    layout->byWeightWeights = malloc(edges * sizeof(int));
+    WeightedNeighbour *row = malloc(n * sizeof(WeightedNeighbour));
+    for (int from = 0; from < n; from++) {
+        int count = 0;
+        for (int col = 0; col < n; col++) {
+            int dist = edgeMatrix[from * n + col];
+            if (from == col || dist == 0) continue;
+            row[count].weight = dist;
+            row[count].node = col;
+            count++;
+        }
+        qsort(row, count, sizeof(WeightedNeighbour), compare_by_weight);
+        int start = layout->byWeightStart[from];
+        for (int e = 0; e < count; e++) {
+            layout->byWeightNeighbours[start + e] = row[e].node;
+            layout->byWeightWeights[start + e] = row[e].weight;
+        }
+    }
+    free(row);
+}
+
+/*
+ * Builds the requested layout of edgeMatrix, which must stay alive as long as the layout.
+ * A narrow layout that cannot hold all weights falls back to the plain dense one.
+ */
+void init_edge_layout(EdgeLayout *layout, const int *edgeMatrix, int n, enum EdgeLayoutKind kind, bool sortByWeight) {
+    memset(layout, 0, sizeof(EdgeLayout));
+    layout->n = n;
+    layout->dense = edgeMatrix;
+    if (kind == LAYOUT_AUTO) kind = choose_layout(edgeMatrix, n);
+    if (kind == LAYOUT_DENSE8 && !fits_weights(edgeMatrix, n, UINT8_MAX)) kind = LAYOUT_DENSE16;
+    if (kind == LAYOUT_DENSE16 && !fits_weights(edgeMatrix, n, UINT16_MAX)) kind = LAYOUT_DENSE;
+    size_t entries = (size_t) n * n;
+    // the narrow copies end in a word of padding, so the row kernels may read the last word of the last row whole,
+    // and leave the diagonal at 0 since it is no edge
+    if (kind == LAYOUT_DENSE8) {
+        layout->dense8 = calloc(entries + ROW_WORD_BITS, sizeof(uint8_t));
+        for (size_t e = 0; e < entries; e++) layout->dense8[e] = e % (n + 1) == 0 ? 0 : (uint8_t) edgeMatrix[e];
+    } else if (kind == LAYOUT_DENSE16) {
+        layout->dense16 = calloc(entries + ROW_WORD_BITS, sizeof(uint16_t));
+        for (size_t e = 0; e < entries; e++) layout->dense16[e] = e % (n + 1) == 0 ? 0 : (uint16_t) edgeMatrix[e];
+    } else if (kind == LAYOUT_SPARSE) {
+        build_csr(layout, edgeMatrix, n);
+    }
+    if (sortByWeight) build_by_weight(layout, edgeMatrix, n);
+    layout->kind = kind;
+    layout->rowKernel = ROW_KERNEL_SCALAR;
+#ifdef ROW_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) layout->rowKernel = ROW_KERNEL_AVX2;
+    if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl")) layout->rowKernel = ROW_KERNEL_AVX512;
+#endif
+}
+
+void free_edge_layout(EdgeLayout *layout) {
+    free(layout->dense8);
+    free(layout->dense16);
+    free(layout->rowStart);
+    free(layout->neighbours);
+    free(layout->weights);
+    free(layout->byWeightStart);
+    free(layout->byWeightNeighbours);
+    free(layout->byWeightWeights);
+}
+
+const char *get_row_kernel_name(enum RowKernel kernel) {
+    switch (kernel) {
+        case ROW_KERNEL_AVX512:
+            return "avx512";
+        case ROW_KERNEL_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+/*
+ * The word kernels read the 32 weights from row[0] on and return the bits of the existing edges of at most limit,
+ * in over those of the longer ones. The SIMD kernels read the whole word, past the row only where the layout is padded.
+ * The scalar one only looks at the unvisited nodes, which also keeps it inside the row in its last word.
+ */
+static unsigned int scan_word_scalar(const EdgeLayout *layout, int from, int word, unsigned int unvisited, int limit,
+                                     unsigned int *over) {
+    unsigned int bits = 0;
+    *over = 0;
+    while (unvisited != 0) {
+        int bit = __builtin_ctz(unvisited);
+        unvisited &= unvisited - 1;
+        int dist = get_edge_dist(layout, from, word * ROW_WORD_BITS + bit);
+        if (dist == 0) continue;
+        if (dist <= limit) {
+            bits |= 1u << bit;
+        } else {
+            *over |= 1u << bit;
+        }
+    }
+    return bits;
+}
+
+#ifdef ROW_KERNELS_X86
+// a compare result of 8 ints as 8 bits
+__attribute__((target("avx2")))
+static inline unsigned int get_mask_avx2_32(__m256i compare) {
+    return (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(compare));
+}
+
+__attribute__((target("avx2")))
+static unsigned int scan_word_avx2_32(const int *row, int limit, unsigned int *over) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i max = _mm256_set1_epi32(limit);
+    unsigned int missing = 0, longer = 0;
+    for (int part = 0; part < 4; part++) {
+        __m256i dist = _mm256_loadu_si256((const __m256i *) &row[part * 8]);
+        missing |= get_mask_avx2_32(_mm256_cmpeq_epi32(dist, zero)) << (part * 8);
+        longer |= get_mask_avx2_32(_mm256_cmpgt_epi32(dist, max)) << (part * 8);
+    }
+    *over = longer;
+    return ~missing & ~longer;
+}
+
+// 16 bit weights compare unsigned, and both halves of the word are packed into bytes to get one bit per node
+__attribute__((target("avx2")))
+static unsigned int scan_word_avx2_16(const uint16_t *row, int limit, unsigned int *over) {
+    __m256i zero = _mm256_setzero_si256();
+    __m256i max = _mm256_set1_epi16((short) (uint16_t) (limit > UINT16_MAX ? UINT16_MAX : limit));
+    __m256i low = _mm256_loadu_si256((const __m256i *) row);
+    __m256i high = _mm256_loadu_si256((const __m256i *) &row[16]);
+    __m256i missing = _mm256_packs_epi16(_mm256_cmpeq_epi16(low, zero), _mm256_cmpeq_epi16(high, zero));
+    __m256i within = _mm256_packs_epi16(_mm256_cmpeq_epi16(_mm256_min_epu16(low, max), low),
+                                        _mm256_cmpeq_epi16(_mm256_min_epu16(high, max), high));
+    // packs interleaves the 128 bit lanes of its inputs
+    unsigned int existing = ~(unsigned int) _mm256_movemask_epi8(_mm256_permute4x64_epi64(missing, 0xD8));
+    unsigned int bits = (unsigned int) _mm256_movemask_epi8(_mm256_permute4x64_epi64(within, 0xD8));
+    *over = existing & ~bits;
+    return existing & bits;
+}
+
+__attribute__((target("avx2")))
+static unsigned int scan_word_avx2_8(const uint8_t *row, int limit, unsigned int *over) {
+    __m256i max = _mm256_set1_epi8((char) (uint8_t) (limit > UINT8_MAX ? UINT8_MAX : limit));
+    __m256i dist = _mm256_loadu_si256((const __m256i *) row);
+    unsigned int existing = ~(unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(dist, _mm256_setzero_si256()));
+    unsigned int bits = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(dist, max), dist));
+    *over = existing & ~bits;
+    return existing & bits;
+}
+
+// AVX-512 compares straight into bit masks
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static unsigned int scan_word_avx512_32(const int *row, int limit, unsigned int *over) {
+    __m512i max = _mm512_set1_epi32(limit);
+    __m512i low = _mm512_loadu_si512(row);
+    __m512i high = _mm512_loadu_si512(&row[16]);
+    unsigned int existing = _mm512_test_epi32_mask(low, low) | (unsigned int) _mm512_test_epi32_mask(high, high) << 16;
+    unsigned int bits = _mm512_cmple_epi32_mask(low, max) | (unsigned int) _mm512_cmple_epi32_mask(high, max) << 16;
+    *over = existing & ~bits;
+    return existing & bits;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static unsigned int scan_word_avx512_16(const uint16_t *row, int limit, unsigned int *over) {
+    __m512i max = _mm512_set1_epi16((short) (uint16_t) (limit > UINT16_MAX ? UINT16_MAX : limit));
+    __m512i dist = _mm512_loadu_si512(row);
+    unsigned int existing = _mm512_test_epi16_mask(dist, dist);
+    unsigned int bits = _mm512_cmple_epu16_mask(dist, max);
+    *over = existing & ~bits;
+    return existing & bits;
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+static unsigned int scan_word_avx512_8(const uint8_t *row, int limit, unsigned int *over) {
+    __m256i max = _mm256_set1_epi8((char) (uint8_t) (limit > UINT8_MAX ? UINT8_MAX : limit));
+    __m256i dist = _mm256_loadu_si256((const __m256i *) row);
+    unsigned int existing = _mm256_test_epi8_mask(dist, dist);
+    unsigned int bits = _mm256_cmple_epu8_mask(dist, max);
+    *over = existing & ~bits;
+    return existing & bits;
+}
+#endif
+
+/*
+ * Filters one word of the row of from in a single pass instead of one candidate at a time: returns the nodes of
+ * unvisited that from has an edge of at most budget to, and in over the unvisited neighbours the budget drops,
+ * so callers can still count them as pruned. Nodes past the row must be left out of unvisited, whatever the
+ * kernel read for them is masked off.
+ */
+unsigned int get_row_candidates(const EdgeLayout *layout, int from, int word, unsigned int unvisited, long budget,
+                                unsigned int *over) {
+    int limit = budget < 0 ? 0 : budget > INT_MAX ? INT_MAX : (int) budget;
+#ifdef ROW_KERNELS_X86
+    bool padded = layout->kind == LAYOUT_DENSE8 || layout->kind == LAYOUT_DENSE16;
+    if (layout->rowKernel != ROW_KERNEL_SCALAR && (padded || (word + 1) * ROW_WORD_BITS <= layout->n)) {
+        size_t start = (size_t) from * layout->n + word * ROW_WORD_BITS;
+        bool avx512 = layout->rowKernel == ROW_KERNEL_AVX512;
+        unsigned int bits;
+        switch (layout->kind) {
+            case LAYOUT_DENSE8:
+                bits = avx512 ? scan_word_avx512_8(&layout->dense8[start], limit, over)
+                              : scan_word_avx2_8(&layout->dense8[start], limit, over);
+                break;
+            case LAYOUT_DENSE16:
+                bits = avx512 ? scan_word_avx512_16(&layout->dense16[start], limit, over)
+                              : scan_word_avx2_16(&layout->dense16[start], limit, over);
+                break;
+            default:
+                bits = avx512 ? scan_word_avx512_32(&layout->dense[start], limit, over)
+                              : scan_word_avx2_32(&layout->dense[start], limit, over);
+                break;
+        }
+        *over &= unvisited;
+        return bits & unvisited;
+    }
+#endif
+    return scan_word_scalar(layout, from, word, unvisited, limit, over);
+}
@@ -0,0 +1,59 @@
+#ifndef TRAVELINGSALESMAN_EDGELAYOUT_H
+#define TRAVELINGSALESMAN_EDGELAYOUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum EdgeLayoutKind {
+    LAYOUT_AUTO, LAYOUT_DENSE, LAYOUT_DENSE16, LAYOUT_DENSE8, LAYOUT_SPARSE
+};
+
+enum RowKernel {
+    ROW_KERNEL_SCALAR, ROW_KERNEL_AVX2, ROW_KERNEL_AVX512
+};
+
+/*
+ * Copy of the edge matrix in the form the search reads it from.
+ * dense always points to the original int matrix. The narrow layouts add a uint16/uint8 copy of it,
+ * the sparse layout the existing out-edges of every node in CSR form, sorted by target node.
+ * Independent of the layout, the out-edges can additionally be kept sorted by weight (byWeight*),
+ * for searches that try the cheapest continuation first.
+ * rowKernel is the widest instruction set the CPU runs get_row_candidates with, a caller may lower it.
+ */
+typedef struct {
+    enum EdgeLayoutKind kind;
+    enum RowKernel rowKernel;
+    int n;
+    const int *dense;
+    uint16_t *dense16;
+    uint8_t *dense8;
+    int *rowStart;
+    int *neighbours;
+    int *weights;
+    int *byWeightStart;
+    int *byWeightNeighbours;
+    int *byWeightWeights;
+} EdgeLayout;
+
+bool parse_edge_layout(const char *arg, enum EdgeLayoutKind *kind);
+const char *get_edge_layout_name(enum EdgeLayoutKind kind);
+void init_edge_layout(EdgeLayout *layout, const int *edgeMatrix, int n, enum EdgeLayoutKind kind, bool sortByWeight);
+void free_edge_layout(EdgeLayout *layout);
+const char *get_row_kernel_name(enum RowKernel kernel);
+unsigned int get_row_candidates(const EdgeLayout *layout, int from, int word, unsigned int unvisited, long budget,
+                                unsigned int *over);
+
+static inline int get_edge_dist(const EdgeLayout *layout, int from, int to) {
+    size_t e = (size_t) from * layout->n + to;
+    switch (layout->kind) {
+        case LAYOUT_DENSE8:
+            return layout->dense8[e];
+        case LAYOUT_DENSE16:
+            return layout->dense16[e];
+        default:
+            return layout->dense[e];
+    }
+}
+
+#endif //TRAVELINGSALESMAN_EDGELAYOUT_H
@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "GraphIO.h"
+
+/*
+ * Graph input from files.
+ * TSPLIB: TSP/ATSP instances given as EXPLICIT matrices (full, upper or lower triangle, with or without
+ * diagonal) or as EUC_2D/CEIL_2D/GEO coordinates. Since 0 marks a missing edge in the edge matrix,
+ * zero distances between distinct nodes (e.g. duplicate coordinates) are raised to 1.
+ * Binary: the magic "TSPB", the node count as int32 and the row-major int32 matrix in host byte order.
+ * The file is mapped copy-on-write and the matrix is used in place, so loading costs no parsing.
+ */
+
+#define BINARY_MAGIC "TSPB"
+#define BINARY_HEADER_SIZE 8
+#define LINE_LEN 256
+#define GEO_PI 3.141592
+#define GEO_EARTH_RADIUS 6378.388
+
+enum WeightType {
+    WEIGHT_UNKNOWN, WEIGHT_EXPLICIT, WEIGHT_EUC_2D, WEIGHT_CEIL_2D, WEIGHT_GEO
+};
+
+enum WeightFormat {
+    FORMAT_UNKNOWN, FORMAT_FUNCTION, FORMAT_FULL_MATRIX, FORMAT_UPPER_ROW, FORMAT_LOWER_ROW,
+    FORMAT_UPPER_DIAG_ROW, FORMAT_LOWER_DIAG_ROW
+};
+
+static char *trim(char *s) {
+    while (isspace((unsigned char) *s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char) end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+static enum WeightType parse_weight_type(const char *value) {
+    if (strcmp(value, "EXPLICIT") == 0) return WEIGHT_EXPLICIT;
+    if (strcmp(value, "EUC_2D") == 0) return WEIGHT_EUC_2D;
+    if (strcmp(value, "CEIL_2D") == 0) return WEIGHT_CEIL_2D;
+    if (strcmp(value, "GEO") == 0) return WEIGHT_GEO;
+    return WEIGHT_UNKNOWN;
+}
+
+// the column-wise formats of a symmetric matrix list the same numbers as the row-wise format of the other triangle
+static enum WeightFormat parse_weight_format(const char *value) {
+    if (strcmp(value, "FUNCTION") == 0) return FORMAT_FUNCTION;
+    if (strcmp(value, "FULL_MATRIX") == 0) return FORMAT_FULL_MATRIX;
+    if (strcmp(value, "UPPER_ROW") == 0 || strcmp(value, "LOWER_COL") == 0) return FORMAT_UPPER_ROW;
+    if (strcmp(value, "LOWER_ROW") == 0 || strcmp(value, "UPPER_COL") == 0) return FORMAT_LOWER_ROW;
+    if (strcmp(value, "UPPER_DIAG_ROW") == 0 || strcmp(value, "LOWER_DIAG_COL") == 0) return FORMAT_UPPER_DIAG_ROW;
+    if (strcmp(value, "LOWER_DIAG_ROW") == 0 || strcmp(value, "UPPER_DIAG_COL") == 0) return FORMAT_LOWER_DIAG_ROW;
+    return FORMAT_UNKNOWN;
+}
+
+static void set_symmetric(int *edgeMatrix, int n, int i, int j, int dist) {
+    edgeMatrix[i * n + j] = dist;
+    edgeMatrix[j * n + i] = dist;
+}
+
+static bool read_explicit_weights(FILE *file, int *edgeMatrix, int n, enum WeightFormat format) {
+    double value;
+    for (int i = 0; i < n; i++) {
+        int first = 0, last = n - 1;
+        switch (format) {
+            case FORMAT_UPPER_ROW:
+                first = i + 1;
+                break;
+            case FORMAT_LOWER_ROW:
+                last = i - 1;
+                break;
+            case FORMAT_UPPER_DIAG_ROW:
+                first = i;
+                break;
+            case FORMAT_LOWER_DIAG_ROW:
+                last = i;
+                break;
+            default:
+                break;
+        }
+        for (int j = first; j <= last; j++) {
+            if (fscanf(file, "%lf", &value) != 1) return false;
+            int dist = (int) lround(value);
+            if (format == FORMAT_FULL_MATRIX) edgeMatrix[i * n + j] = dist;
+            else set_symmetric(edgeMatrix, n, i, j, dist);
+        }
+    }
+    return true;
+}
+
+static double geo_radians(double coord) {
+    int deg = (int) coord;
+    double min = coord - deg;
+    return GEO_PI * (deg + 5.0 * min / 3.0) / 180.0;
+}
+
+static int coord_distance(enum WeightType type, const double *x, const double *y, int i, int j) {
+    if (type == WEIGHT_GEO) {
+        double latI = geo_radians(x[i]), lonI = geo_radians(y[i]);
+        double latJ = geo_radians(x[j]), lonJ = geo_radians(y[j]);
+        double q1 = cos(lonI - lonJ);
+        double q2 = cos(latI - latJ);
+        double q3 = cos(latI + latJ);
+        return (int) (GEO_EARTH_RADIUS * acos(0.5 * ((1.0 + q1) * q2 - (1.0 - q1) * q3)) + 1.0);
+    }
+    double d = sqrt((x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]));
+    return type == WEIGHT_CEIL_2D ? (int) ceil(d) : (int) lround(d);
+}
+
+static bool read_coordinates(FILE *file, int *edgeMatrix, int n, enum WeightType type) {
+    double *x = malloc(n * sizeof(double));
+    double *y = malloc(n * sizeof(double));
+    bool ok = true;
+    for (int k = 0; k < n && ok; k++) {
+        int id;
+        double px, py;
+        if (fscanf(file, "%d %lf %lf", &id, &px, &py) != 3 || id < 1 || id > n) {
+            ok = false;
+        } else {
+            x[id - 1] = px;
+            y[id - 1] = py;
+        }
+    }
+    for (int i = 0; i < n && ok; i++) {
+        for (int j = i + 1; j < n; j++) {
+            set_symmetric(edgeMatrix, n, i, j, coord_distance(type, x, y, i, j));
+        }
+    }
+    free(x);
+    free(y);
+    return ok;
+}
+
+/*
+ * Reads a TSPLIB file into a newly allocated row-major matrix.
+ * Returns NULL and prints the reason if the file cannot be read or uses an unsupported format.
+ */
+int *load_tsplib(const char *fileName, int *nNodes) {
+    FILE *file = fopen(fileName, "r");
+    if (file == NULL) {
+        printf("Could not open graph file %s!\n", fileName);
+        return NULL;
+    }
+    int n = 0;
+    enum WeightType type = WEIGHT_UNKNOWN;
+    enum WeightFormat format = FORMAT_UNKNOWN;
+    int *edgeMatrix = NULL;
+    bool ok = false, reported = false;
+    char line[LINE_LEN];
+    while (fgets(line, LINE_LEN, file) != NULL) {
+        char *key = trim(line);
+        char *value = strchr(key, ':');
+        if (value != NULL) {
+            *value++ = '\0';
+            value = trim(value);
+            key = trim(key);
+        }
+        if (strcmp(key, "DIMENSION") == 0 && value != NULL) {
+            n = (int) strtol(value, NULL, 10);
+        } else if (strcmp(key, "EDGE_WEIGHT_TYPE") == 0 && value != NULL) {
+            type = parse_weight_type(value);
+            if (type == WEIGHT_UNKNOWN) {
+                printf("Unsupported EDGE_WEIGHT_TYPE %s!\n", value);
+                reported = true;
+                break;
+            }
+        } else if (strcmp(key, "EDGE_WEIGHT_FORMAT") == 0 && value != NULL) {
+            format = parse_weight_format(value);
+            if (format == FORMAT_UNKNOWN) {
+                printf("Unsupported EDGE_WEIGHT_FORMAT %s!\n", value);
+                reported = true;
+                break;
+            }
+        } else if (strcmp(key, "EDGE_WEIGHT_SECTION") == 0 || strcmp(key, "NODE_COORD_SECTION") == 0) {
+            bool explicitSection = key[0] == 'E';
+            if (n < 1) {
+                printf("Missing DIMENSION before %s!\n", key);
+                reported = true;
+                break;
+            }
+            if (explicitSection && (type != WEIGHT_EXPLICIT || format == FORMAT_UNKNOWN || format == FORMAT_FUNCTION)) {
+                printf("EDGE_WEIGHT_SECTION requires EDGE_WEIGHT_TYPE EXPLICIT and an EDGE_WEIGHT_FORMAT!\n");
+                reported = true;
+                break;
+            }
+            if (!explicitSection && (type == WEIGHT_EXPLICIT || type == WEIGHT_UNKNOWN)) {
+                printf("NODE_COORD_SECTION requires a coordinate EDGE_WEIGHT_TYPE!\n");
+                reported = true;
+                break;
+            }
+            edgeMatrix = calloc((size_t) n * n, sizeof(int));
+            if (edgeMatrix == NULL) {
+                printf("Not enough memory for %d nodes!\n", n);
+                reported = true;
+                break;
+            }
+            ok = explicitSection ? read_explicit_weights(file, edgeMatrix, n, format)
+                                 : read_coordinates(file, edgeMatrix, n, type);
+            if (!ok) printf("Malformed %s in %s!\n", key, fileName);
+            reported = true;
+            break;
+        } else if (strcmp(key, "EOF") == 0) {
+            break;
+        }
+    }
+    fclose(file);
+    if (!ok) {
+        if (!reported) printf("No edge weights found in %s!\n", fileName);
+        free(edgeMatrix);
+        return NULL;
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (i == j) edgeMatrix[i * n + j] = 0;
+            else if (edgeMatrix[i * n + j] <= 0) edgeMatrix[i * n + j] = 1;
+        }
+    }
+    *nNodes = n;
+    return edgeMatrix;
+}
+
+bool is_binary_matrix_file(const char *fileName) {
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL) return false;
+    char magic[4];
+    bool binary = fread(magic, 1, 4, file) == 4 && memcmp(magic, BINARY_MAGIC, 4) == 0;
+    fclose(file);
+    return binary;
+}
+
+/*
+ * Maps a binary matrix file copy-on-write, so the solver may modify the matrix without touching the file.
+ * The returned matrix must be released with unload_binary_matrix.
+ */
+int *load_binary_matrix(const char *fileName, int *nNodes) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        printf("Could not open graph file %s!\n", fileName);
+        return NULL;
+    }
+    struct stat st;
+    int32_t n = 0;
+    if (fstat(fd, &st) != 0 || st.st_size < BINARY_HEADER_SIZE || pread(fd, &n, sizeof(n), 4) != sizeof(n)
+        || n < 1 || st.st_size != BINARY_HEADER_SIZE + (off_t) n * n * (off_t) sizeof(int32_t)) {
+        printf("Malformed binary matrix %s!\n", fileName);
+        close(fd);
+        return NULL;
+    }
+    char *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        printf("Could not map graph file %s!\n", fileName);
+        return NULL;
+    }
+    *nNodes = n;
+    return (int *) (map + BINARY_HEADER_SIZE);
+}
+
+void unload_binary_matrix(int *edgeMatrix, int nNodes) {
+    munmap((char *) edgeMatrix - BINARY_HEADER_SIZE,
+           BINARY_HEADER_SIZE + (size_t) nNodes * nNodes * sizeof(int32_t));
+}
+
+bool write_binary_matrix(const char *fileName, const int *edgeMatrix, int nNodes) {
+    FILE *file = fopen(fileName, "wb");
+    if (file == NULL) {
+        printf("Could not create %s!\n", fileName);
+        return false;
+    }
+    int32_t n = nNodes;
+    size_t entries = (size_t) nNodes * nNodes;
+    bool ok = fwrite(BINARY_MAGIC, 1, 4, file) == 4 && fwrite(&n, sizeof(n), 1, file) == 1
+              && fwrite(edgeMatrix, sizeof(int32_t), entries, file) == entries;
+    ok &= fclose(file) == 0;
+    if (!ok) printf("Could not write %s!\n", fileName);
+    return ok;
+}
+
+/*
+ * A batch file is a sequence of binary matrices, e.g. files of write_binary_matrix joined with cat.
+ * Returns all matrices back to back and their node counts in *nodeCounts, both to be freed by the caller.
+ */
+int *load_binary_batch(const char *fileName, int *count, int **nodeCounts) {
+    FILE *file = fopen(fileName, "rb");
+    if (file == NULL) {
+        printf("Could not open batch file %s!\n", fileName);
+        return NULL;
+    }
+    int *matrices = NULL;
+    int *counts = NULL;
+    size_t entries = 0;
+    int instances = 0;
+    char magic[4];
+    bool ok = true;
+    while (fread(magic, 1, 4, file) == 4) {
+        int32_t n = 0;
+        if (memcmp(magic, BINARY_MAGIC, 4) != 0 || fread(&n, sizeof(n), 1, file) != 1 || n < 1) {
+            ok = false;
+            break;
+        }
+        size_t size = (size_t) n * n;
+        matrices = realloc(matrices, (entries + size) * sizeof(int));
+        counts = realloc(counts, (instances + 1) * sizeof(int));
+        if (fread(&matrices[entries], sizeof(int32_t), size, file) != size) {
+            ok = false;
+            break;
+        }
+        counts[instances++] = n;
+        entries += size;
+    }
+    fclose(file);
+    if (!ok || instances == 0) {
+        printf("Malformed batch file %s!\n", fileName);
+        free(matrices);
+        free(counts);
+        return NULL;
+    }
+    *count = instances;
+    *nodeCounts = counts;
+    return matrices;
+}
+
+// picks the binary or the TSPLIB reader by the file's magic bytes
+int *load_graph_file(const char *fileName, int *nNodes) {
+    if (is_binary_matrix_file(fileName)) return load_binary_matrix(fileName, nNodes);
+    return load_tsplib(fileName, nNodes);
+}
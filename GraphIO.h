@@ -0,0 +1,14 @@
+#ifndef TRAVELINGSALESMAN_GRAPHIO_H
+#define TRAVELINGSALESMAN_GRAPHIO_H
+
+#include <stdbool.h>
+
+int *load_graph_file(const char *fileName, int *nNodes);
+int *load_tsplib(const char *fileName, int *nNodes);
+int *load_binary_matrix(const char *fileName, int *nNodes);
+void unload_binary_matrix(int *edgeMatrix, int nNodes);
+bool is_binary_matrix_file(const char *fileName);
+bool write_binary_matrix(const char *fileName, const int *edgeMatrix, int nNodes);
+int *load_binary_batch(const char *fileName, int *count, int **nodeCounts);
+
+#endif //TRAVELINGSALESMAN_GRAPHIO_H
@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <string.h>
+#include "GraphReduction.h"
+
+#define BITS_PER_WORD 32
+#define NO_NODE (-1)
+
+static bool has_edge(const int *edgeMatrix, int n, int from, int to) {
+    return from != to && edgeMatrix[(size_t) from * n + to] != 0;
+}
+
+static void drop_edge(int *edgeMatrix, int n, int from, int to, GraphReduction *reduction) {
+    edgeMatrix[(size_t) from * n + to] = 0;
+    reduction->droppedEdges++;
+}
+
+static void count_degrees(const int *edgeMatrix, int n, int *outDegree, int *inDegree) {
+    memset(outDegree, 0, n * sizeof(int));
+    memset(inDegree, 0, n * sizeof(int));
+    for (int from = 0; from < n; from++) {
+        for (int to = 0; to < n; to++) {
+            if (!has_edge(edgeMatrix, n, from, to)) continue;
+            outDegree[from]++;
+            inDegree[to]++;
+        }
+    }
+}
+
+// the edge of a single out- or in-edge node, false if a node would have to be left or entered twice
+static bool find_forced_edges(const int *edgeMatrix, int n, const int *outDegree, const int *inDegree,
+                              int *next, int *previous) {
+    for (int node = 0; node < n; node++) {
+        next[node] = NO_NODE;
+        previous[node] = NO_NODE;
+    }
+    for (int from = 0; from < n; from++) {
+        for (int to = 0; to < n; to++) {
+            if (!has_edge(edgeMatrix, n, from, to)) continue;
+            if (outDegree[from] != 1 && inDegree[to] != 1) continue;
+            if ((next[from] != NO_NODE && next[from] != to) || (previous[to] != NO_NODE && previous[to] != from)) {
+                return false;
+            }
+            next[from] = to;
+            previous[to] = from;
+        }
+    }
+    return true;
+}
+
+// drops the other edges out of the source and into the target of every forced edge
+static bool drop_competing_edges(int *edgeMatrix, int n, const int *next, GraphReduction *reduction) {
+    bool dropped = false;
+    for (int from = 0; from < n; from++) {
+        if (next[from] == NO_NODE) continue;
+        for (int other = 0; other < n; other++) {
+            if (other != next[from] && has_edge(edgeMatrix, n, from, other)) {
+                drop_edge(edgeMatrix, n, from, other, reduction);
+                dropped = true;
+            }
+            if (other != from && has_edge(edgeMatrix, n, other, next[from])) {
+                drop_edge(edgeMatrix, n, other, next[from], reduction);
+                dropped = true;
+            }
+        }
+    }
+    return dropped;
+}
+
+/*
+ * Once no forced edge competes with another edge, the forced edges form disjoint chains and cycles.
+ * Drops the edge closing a chain of fewer than n nodes, false if a cycle is shorter than the tour.
+ */
+static bool close_chains(int *edgeMatrix, int n, const int *next, const int *previous, bool *onChain,
+                         GraphReduction *reduction, bool *dropped) {
+    memset(onChain, 0, n * sizeof(bool));
+    for (int start = 0; start < n; start++) {
+        if (previous[start] != NO_NODE || next[start] == NO_NODE) continue;
+        int end = start, nodes = 1;
+        onChain[start] = true;
+        while (next[end] != NO_NODE) {
+            end = next[end];
+            onChain[end] = true;
+            nodes++;
+        }
+        if (nodes < n && has_edge(edgeMatrix, n, end, start)) {
+            drop_edge(edgeMatrix, n, end, start, reduction);
+            *dropped = true;
+        }
+    }
+    for (int start = 0; start < n; start++) {
+        if (onChain[start] || next[start] == NO_NODE) continue;
+        int nodes = 0;
+        for (int node = start; !onChain[node]; node = next[node]) {
+            onChain[node] = true;
+            nodes++;
+        }
+        if (nodes < n) return false;
+    }
+    return true;
+}
+
+// whether every node is reached from 0, following the edges forwards or backwards
+static bool reaches_all(const int *edgeMatrix, int n, bool backwards, int *queue, bool *reached) {
+    memset(reached, 0, n * sizeof(bool));
+    int head = 0, tail = 0;
+    queue[tail++] = 0;
+    reached[0] = true;
+    while (head < tail) {
+        int node = queue[head++];
+        for (int other = 0; other < n; other++) {
+            if (reached[other]) continue;
+            if (!(backwards ? has_edge(edgeMatrix, n, other, node) : has_edge(edgeMatrix, n, node, other))) continue;
+            reached[other] = true;
+            queue[tail++] = other;
+        }
+    }
+    return tail == n;
+}
+
+bool reduce_graph(int *edgeMatrix, int n, GraphReduction *reduction) {
+    reduction->droppedEdges = 0;
+    reduction->forcedEdges = 0;
+    if (n < 2) return true;
+    int *outDegree = malloc(n * sizeof(int));
+    int *inDegree = malloc(n * sizeof(int));
+    int *next = malloc(n * sizeof(int));
+    int *previous = malloc(n * sizeof(int));
+    bool *marks = malloc(n * sizeof(bool));
+    bool feasible = true, dropped = true;
+    while (feasible && dropped) {
+        dropped = false;
+        count_degrees(edgeMatrix, n, outDegree, inDegree);
+        for (int node = 0; node < n && feasible; node++) {
+            feasible = outDegree[node] > 0 && inDegree[node] > 0;
+        }
+        if (!feasible) break;
+        feasible = find_forced_edges(edgeMatrix, n, outDegree, inDegree, next, previous);
+        if (!feasible) break;
+        dropped = drop_competing_edges(edgeMatrix, n, next, reduction);
+        // the degrees are stale now, the chains are only closed once the forced edges stand alone
+        if (!dropped) feasible = close_chains(edgeMatrix, n, next, previous, marks, reduction, &dropped);
+    }
+    if (feasible) {
+        for (int node = 0; node < n; node++) {
+            if (next[node] != NO_NODE) reduction->forcedEdges++;
+        }
+        feasible = reaches_all(edgeMatrix, n, false, outDegree, marks)
+                   && reaches_all(edgeMatrix, n, true, outDegree, marks);
+    }
+    free(outDegree);
+    free(inDegree);
+    free(next);
+    free(previous);
+    free(marks);
+    return feasible;
+}
+
+bool is_complete_graph(const int *edgeMatrix, int n) {
+    for (int from = 0; from < n; from++) {
+        for (int to = 0; to < n; to++) {
+            if (from != to && !has_edge(edgeMatrix, n, from, to)) return false;
+        }
+    }
+    return true;
+}
+
+void init_reach_masks(ReachMasks *masks, const int *edgeMatrix, int n) {
+    masks->n = n;
+    masks->words = (n + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    masks->out = calloc((size_t) n * masks->words, sizeof(unsigned int));
+    masks->in = calloc((size_t) n * masks->words, sizeof(unsigned int));
+    for (int from = 0; from < n; from++) {
+        for (int to = 0; to < n; to++) {
+            if (!has_edge(edgeMatrix, n, from, to)) continue;
+            masks->out[(size_t) from * masks->words + to / BITS_PER_WORD] |= 1u << (to % BITS_PER_WORD);
+            masks->in[(size_t) to * masks->words + from / BITS_PER_WORD] |= 1u << (from % BITS_PER_WORD);
+        }
+    }
+}
+
+void free_reach_masks(ReachMasks *masks) {
+    free(masks->out);
+    free(masks->in);
+    masks->out = NULL;
+    masks->in = NULL;
+}
+
+// whether the neighbours of start, followed through unvisited nodes only, take in every unvisited node
+static bool reaches_unvisited(const unsigned int *neighbours, int words, int start, const int *visited,
+                              unsigned int *reached, unsigned int *pending) {
+    int missing = 0;
+    for (int w = 0; w < words; w++) {
+        unsigned int unvisited = ~(unsigned int) visited[w];
+        reached[w] = neighbours[(size_t) start * words + w] & unvisited;
+        pending[w] = reached[w];
+        missing += __builtin_popcount(unvisited) - __builtin_popcount(reached[w]);
+    }
+    // on dense graphs the first few nodes usually reach everything, so the search stops as soon as nothing is missing
+    int w = 0;
+    while (missing > 0 && w < words) {
+        if (pending[w] == 0) {
+            w++;
+            continue;
+        }
+        int node = w * BITS_PER_WORD + __builtin_ctz(pending[w]);
+        pending[w] &= pending[w] - 1;
+        const unsigned int *row = &neighbours[(size_t) node * words];
+        for (int x = 0; x < words; x++) {
+            unsigned int added = row[x] & ~(unsigned int) visited[x] & ~reached[x];
+            if (added == 0) continue;
+            reached[x] |= added;
+            pending[x] |= added;
+            missing -= __builtin_popcount(added);
+            if (x < w) w = x;
+        }
+    }
+    return missing == 0;
+}
+
+bool can_complete(const ReachMasks *masks, int last, const int *visited, unsigned int *scratch) {
+    unsigned int *reached = scratch, *pending = &scratch[masks->words];
+    return reaches_unvisited(masks->out, masks->words, last, visited, reached, pending)
+           && reaches_unvisited(masks->in, masks->words, 0, visited, reached, pending);
+}
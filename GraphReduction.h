@@ -0,0 +1,38 @@
+#ifndef TRAVELINGSALESMAN_GRAPHREDUCTION_H
+#define TRAVELINGSALESMAN_GRAPHREDUCTION_H
+
+#include <stdbool.h>
+
+/*
+ * Preprocessing of an edge matrix before the search. A node with a single out-edge (or in-edge) forces it into
+ * every tour, which rules out the other edges into its target (or out of its source), and a chain of forced edges
+ * shorter than the tour rules out the edge closing it into a cycle. Edges no tour can use are set to 0 until
+ * nothing changes any more. The graph has no tour at all if a node loses its last in- or out-edge, the forced
+ * edges close a short cycle or the graph is not strongly connected.
+ */
+typedef struct {
+    int droppedEdges;
+    int forcedEdges;
+} GraphReduction;
+
+bool reduce_graph(int *edgeMatrix, int n, GraphReduction *reduction);
+bool is_complete_graph(const int *edgeMatrix, int n);
+
+/*
+ * The out- and in-neighbours of every node as bitsets over 32-node words, laid out like the visited bitsets of
+ * the path records. can_complete tells whether the unvisited nodes can still be closed into a tour: all of them
+ * reachable from the last node and all of them reaching 0 through unvisited nodes only.
+ * scratch holds two bitsets and belongs to the calling thread.
+ */
+typedef struct {
+    int n;
+    int words;
+    unsigned int *out;
+    unsigned int *in;
+} ReachMasks;
+
+void init_reach_masks(ReachMasks *masks, const int *edgeMatrix, int n);
+void free_reach_masks(ReachMasks *masks);
+bool can_complete(const ReachMasks *masks, int last, const int *visited, unsigned int *scratch);
+
+#endif //TRAVELINGSALESMAN_GRAPHREDUCTION_H
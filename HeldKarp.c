@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <limits.h>
+#include <omp.h>
+#include "HeldKarp.h"
+
+/*
+ * Held-Karp dynamic program over (visited subset, last node).
+ * Node 0 is the fixed start and is left out of the subsets, so bit j of a subset stands for node j + 1.
+ * cost[subset * m + j] holds the cheapest path 0 -> ... -> j + 1 visiting exactly the nodes in subset.
+ * All subsets of one cardinality only depend on the previous layer, so each layer is filled in parallel.
+ * Entries are stored as uint16 whenever no path can exceed that range, halving the table size.
+ */
+
+#define CHUNKS_PER_THREAD 8
+
+static unsigned long long binomial[HK_MAX_NODES + 1][HK_MAX_NODES + 1];
+
+static void init_binomials() {
+    for (int a = 0; a <= HK_MAX_NODES; a++) {
+        binomial[a][0] = 1;
+        for (int b = 1; b <= HK_MAX_NODES; b++) {
+            binomial[a][b] = a == 0 ? 0 : binomial[a - 1][b - 1] + binomial[a - 1][b];
+        }
+    }
+}
+
+// returns the subset of size k with the given rank in colex order (the order next_subset walks)
+static unsigned int unrank_subset(unsigned long long rank, int k) {
+    unsigned int subset = 0;
+    for (int i = k; i >= 1; i--) {
+        int c = i - 1;
+        while (binomial[c + 1][i] <= rank) c++;
+        subset |= 1u << c;
+        rank -= binomial[c][i];
+    }
+    return subset;
+}
+
+// next larger subset with the same number of bits (Gosper's hack)
+static unsigned int next_subset(unsigned int subset) {
+    unsigned int lowest = subset & -subset;
+    unsigned int ripple = subset + lowest;
+    return (((ripple ^ subset) >> 2) / lowest) | ripple;
+}
+
+#define DEFINE_FILL_LAYER(SUFFIX, TYPE, INF)                                                   \
+static void fill_layer_##SUFFIX(const int *edgeMatrix, int n, TYPE *cost, int k) {            \
+    int m = n - 1;                                                                             \
+    unsigned long long count = binomial[m][k];                                                 \
+    long long chunks = (long long) omp_get_max_threads() * CHUNKS_PER_THREAD;                  \
+    if ((unsigned long long) chunks > count) chunks = (long long) count;                       \
+    _Pragma("omp parallel for schedule(dynamic)")                                              \
+    for (long long chunk = 0; chunk < chunks; chunk++) {                                       \
+        unsigned long long first = count * chunk / chunks;                                     \
+        unsigned long long last = count * (chunk + 1) / chunks;                                \
+        unsigned int subset = unrank_subset(first, k);                                         \
+        for (unsigned long long r = first; r < last; r++, subset = next_subset(subset)) {      \
+            for (unsigned int ends = subset; ends != 0; ends &= ends - 1) {                    \
+                int j = __builtin_ctz(ends);                                                   \
+                unsigned int prev = subset & ~(1u << j);                                       \
+                unsigned long long best = INF;                                                 \
+                if (prev == 0) {                                                               \
+                    int dist = edgeMatrix[j + 1];                                              \
+                    if (dist != 0) best = (unsigned long long) dist;                           \
+                }                                                                              \
+                for (unsigned int from = prev; from != 0; from &= from - 1) {                  \
+                    int p = __builtin_ctz(from);                                               \
+                    TYPE c = cost[(size_t) prev * m + p];                                      \
+                    int dist = edgeMatrix[(p + 1) * n + j + 1];                                \
+                    if (c == (INF) || dist == 0) continue;                                     \
+                    unsigned long long total = (unsigned long long) c + dist;                  \
+                    if (total < best) best = total;                                            \
+                }                                                                              \
+                cost[(size_t) subset * m + j] = (TYPE) best;                                   \
+            }                                                                                  \
+        }                                                                                      \
+    }                                                                                          \
+}
+
+DEFINE_FILL_LAYER(u16, uint16_t, UINT16_MAX)
+DEFINE_FILL_LAYER(u32, uint32_t, UINT32_MAX)
+
+static unsigned long long get_cost(const void *cost, bool wide, size_t index) {
+    if (wide) return ((const uint32_t *) cost)[index];
+    return ((const uint16_t *) cost)[index];
+}
+
+static void reconstruct_tour(const int *edgeMatrix, int n, const void *cost, bool wide,
+                             unsigned long long inf, unsigned int subset, int j, int *tour) {
+    int m = n - 1;
+    tour[0] = 0;
+    tour[n] = 0;
+    for (int pos = n - 1; pos >= 1; pos--) {
+        tour[pos] = j + 1;
+        unsigned int prev = subset & ~(1u << j);
+        if (prev == 0) break;
+        unsigned long long target = get_cost(cost, wide, (size_t) subset * m + j);
+        for (unsigned int from = prev; from != 0; from &= from - 1) {
+            int p = __builtin_ctz(from);
+            unsigned long long c = get_cost(cost, wide, (size_t) prev * m + p);
+            int dist = edgeMatrix[(p + 1) * n + j + 1];
+            if (c == inf || dist == 0) continue;
+            if (c + dist == target) {
+                j = p;
+                break;
+            }
+        }
+        subset = prev;
+    }
+}
+
+/*
+ * Computes an optimal tour starting and ending at node 0, treating 0 entries as missing edges.
+ * On success tour holds n + 1 nodes and distance the tour length, or INT_MAX if no tour exists.
+ * Returns false if the instance is too large for the table.
+ */
+bool held_karp_solve(const int *edgeMatrix, int n, int *tour, int *distance) {
+    *distance = INT_MAX;
+    if (n < 2) return true;
+    if (n > HK_MAX_NODES) {
+        printf("Held-Karp supports at most %d nodes!\n", HK_MAX_NODES);
+        return false;
+    }
+    int maxEdge = 0;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (i != j && edgeMatrix[i * n + j] > maxEdge) maxEdge = edgeMatrix[i * n + j];
+        }
+    }
+    long long maxPathCost = (long long) maxEdge * n;
+    if (maxPathCost >= INT_MAX) {
+        printf("Edge weights too large for Held-Karp!\n");
+        return false;
+    }
+    bool wide = maxPathCost >= UINT16_MAX;
+    size_t entrySize = wide ? sizeof(uint32_t) : sizeof(uint16_t);
+    unsigned long long inf = wide ? UINT32_MAX : UINT16_MAX;
+
+    int m = n - 1;
+    size_t entries = ((size_t) 1 << m) * m;
+    void *cost = malloc(entries * entrySize);
+    if (cost == NULL) {
+        printf("Not enough memory for Held-Karp table (%zu bytes)!\n", entries * entrySize);
+        return false;
+    }
+    init_binomials();
+    for (int k = 1; k <= m; k++) {
+        if (wide) fill_layer_u32(edgeMatrix, n, cost, k);
+        else fill_layer_u16(edgeMatrix, n, cost, k);
+    }
+
+    unsigned int full = (unsigned int) (((size_t) 1 << m) - 1);
+    int bestEnd = -1;
+    unsigned long long best = inf;
+    for (int j = 0; j < m; j++) {
+        unsigned long long c = get_cost(cost, wide, (size_t) full * m + j);
+        int distTo0 = edgeMatrix[(j + 1) * n];
+        if (c == inf || distTo0 == 0) continue;
+        if (c + distTo0 < best) {
+            best = c + distTo0;
+            bestEnd = j;
+        }
+    }
+    if (bestEnd >= 0) {
+        reconstruct_tour(edgeMatrix, n, cost, wide, inf, full, bestEnd, tour);
+        *distance = (int) best;
+    }
+    free(cost);
+    return true;
+}
@@ -0,0 +1,10 @@
+#ifndef TRAVELINGSALESMAN_HELDKARP_H
+#define TRAVELINGSALESMAN_HELDKARP_H
+
+#include <stdbool.h>
+
+#define HK_MAX_NODES 32
+
+bool held_karp_solve(const int *edgeMatrix, int n, int *tour, int *distance);
+
+#endif //TRAVELINGSALESMAN_HELDKARP_H
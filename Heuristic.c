@@ -0,0 +1,142 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include "Heuristic.h"
+
+/*
+ * Builds a feasible tour with nearest neighbour construction, improved by 2-opt and Or-opt moves.
+ * Missing edges (0 entries) get a prohibitive cost instead of being forbidden outright,
+ * so the local search can repair a construction that had to take one.
+ * Both move types evaluate the exact directed cost, so they are valid for asymmetric matrices.
+ */
+
+#define MISSING_EDGE_COST (1LL << 40)
+#define OR_OPT_MAX_SEGMENT 3
+
+static long long edge_cost(const int *edgeMatrix, int n, int from, int to) {
+    int dist = edgeMatrix[from * n + to];
+    return dist == 0 ? MISSING_EDGE_COST : dist;
+}
+
+static void nearest_neighbour(const int *edgeMatrix, int n, int *tour) {
+    bool *visited = calloc(n, sizeof(bool));
+    tour[0] = 0;
+    visited[0] = true;
+    for (int pos = 1; pos < n; pos++) {
+        int curr = tour[pos - 1];
+        int next = -1;
+        long long nextCost = LLONG_MAX;
+        for (int i = 0; i < n; i++) {
+            if (visited[i]) continue;
+            long long cost = edge_cost(edgeMatrix, n, curr, i);
+            if (cost < nextCost) {
+                next = i;
+                nextCost = cost;
+            }
+        }
+        tour[pos] = next;
+        visited[next] = true;
+    }
+    tour[n] = 0;
+    free(visited);
+}
+
+// prefix sums of the tour edges walked forwards and backwards, used to price segment reversals in O(1)
+static void compute_prefix_costs(const int *edgeMatrix, int n, const int *tour,
+                                 long long *forward, long long *backward) {
+    forward[0] = 0;
+    backward[0] = 0;
+    for (int pos = 0; pos < n; pos++) {
+        forward[pos + 1] = forward[pos] + edge_cost(edgeMatrix, n, tour[pos], tour[pos + 1]);
+        backward[pos + 1] = backward[pos] + edge_cost(edgeMatrix, n, tour[pos + 1], tour[pos]);
+    }
+}
+
+static void reverse_segment(int *tour, int first, int last) {
+    while (first < last) {
+        int tmp = tour[first];
+        tour[first++] = tour[last];
+        tour[last--] = tmp;
+    }
+}
+
+static bool improve_two_opt(const int *edgeMatrix, int n, int *tour, long long *forward, long long *backward) {
+    bool improved = false;
+    compute_prefix_costs(edgeMatrix, n, tour, forward, backward);
+    for (int i = 1; i < n - 1; i++) {
+        for (int j = i + 1; j < n; j++) {
+            int before = tour[i - 1], first = tour[i], last = tour[j], after = tour[j + 1];
+            long long oldCost = edge_cost(edgeMatrix, n, before, first) + (forward[j] - forward[i])
+                                + edge_cost(edgeMatrix, n, last, after);
+            long long newCost = edge_cost(edgeMatrix, n, before, last) + (backward[j] - backward[i])
+                                + edge_cost(edgeMatrix, n, first, after);
+            if (newCost < oldCost) {
+                reverse_segment(tour, i, j);
+                compute_prefix_costs(edgeMatrix, n, tour, forward, backward);
+                improved = true;
+            }
+        }
+    }
+    return improved;
+}
+
+// moves tour[first..first+len-1] so that it follows position target, keeping its orientation
+static void move_segment(int *tour, int first, int len, int target) {
+    int segment[OR_OPT_MAX_SEGMENT];
+    memcpy(segment, &tour[first], len * sizeof(int));
+    if (target < first) {
+        memmove(&tour[target + 1 + len], &tour[target + 1], (first - target - 1) * sizeof(int));
+        memcpy(&tour[target + 1], segment, len * sizeof(int));
+    } else {
+        memmove(&tour[first], &tour[first + len], (target - first - len + 1) * sizeof(int));
+        memcpy(&tour[target - len + 1], segment, len * sizeof(int));
+    }
+}
+
+static bool improve_or_opt(const int *edgeMatrix, int n, int *tour) {
+    bool improved = false;
+    for (int len = 1; len <= OR_OPT_MAX_SEGMENT; len++) {
+        for (int first = 1; first + len - 1 < n; first++) {
+            int last = first + len - 1;
+            int before = tour[first - 1], after = tour[last + 1];
+            long long removeGain = edge_cost(edgeMatrix, n, before, tour[first])
+                                   + edge_cost(edgeMatrix, n, tour[last], after)
+                                   - edge_cost(edgeMatrix, n, before, after);
+            for (int target = 0; target < n; target++) {
+                if (target >= first - 1 && target <= last) continue;
+                int x = tour[target], y = tour[target + 1];
+                long long insertCost = edge_cost(edgeMatrix, n, x, tour[first])
+                                       + edge_cost(edgeMatrix, n, tour[last], y)
+                                       - edge_cost(edgeMatrix, n, x, y);
+                if (insertCost < removeGain) {
+                    move_segment(tour, first, len, target);
+                    improved = true;
+                    break;
+                }
+            }
+        }
+    }
+    return improved;
+}
+
+/*
+ * Writes a tour of n + 1 nodes starting and ending at node 0 into tour.
+ * Returns its distance, or INT_MAX if local search could not avoid a missing edge.
+ */
+int heuristic_tour(const int *edgeMatrix, int n, int *tour) {
+    if (n < 2) return INT_MAX;
+    long long *forward = malloc((n + 1) * sizeof(long long));
+    long long *backward = malloc((n + 1) * sizeof(long long));
+    nearest_neighbour(edgeMatrix, n, tour);
+    bool improved = true;
+    while (improved) {
+        improved = improve_two_opt(edgeMatrix, n, tour, forward, backward);
+        improved |= improve_or_opt(edgeMatrix, n, tour);
+    }
+    compute_prefix_costs(edgeMatrix, n, tour, forward, backward);
+    long long distance = forward[n];
+    free(forward);
+    free(backward);
+    return distance >= MISSING_EDGE_COST ? INT_MAX : (int) distance;
+}
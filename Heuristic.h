@@ -0,0 +1,6 @@
+#ifndef TRAVELINGSALESMAN_HEURISTIC_H
+#define TRAVELINGSALESMAN_HEURISTIC_H
+
+int heuristic_tour(const int *edgeMatrix, int n, int *tour);
+
+#endif //TRAVELINGSALESMAN_HEURISTIC_H
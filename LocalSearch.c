@@ -0,0 +1,369 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include "LocalSearch.h"
+#include "Util.h"
+
+#define MISSING_EDGE_COST (1LL << 40)
+#define CANDIDATES 8
+#define OR_OPT_MAX_SEGMENT 3
+#define MIN_KICKS 50
+
+struct LocalSearch {
+    const int *edgeMatrix;
+    int n;
+    bool symmetric;
+    // the CANDIDATES cheapest existing edges out of and into every node, cheapest first, -1 where there are fewer
+    int *candOut;
+    int *candIn;
+    // the tour as a cycle of n nodes, the position of every node in it and the best cycle of the current run
+    int *tour;
+    int *pos;
+    int *bestTour;
+    // prefix sums of the tour edges walked forwards and backwards, only kept on asymmetric matrices
+    long long *forward;
+    long long *backward;
+    // the nodes whose neighbourhood may still improve, in a ring buffer; all others have their don't-look bit set
+    int *queue;
+    bool *queued;
+    int queueHead;
+    int queueCount;
+    bool *visited;
+};
+
+static long long edge_cost(const LocalSearch *s, int from, int to) {
+    int dist = s->edgeMatrix[from * s->n + to];
+    return dist == 0 || from == to ? MISSING_EDGE_COST : dist;
+}
+
+static int get_weight(const LocalSearch *s, int node, int other, bool outgoing) {
+    return outgoing ? s->edgeMatrix[node * s->n + other] : s->edgeMatrix[other * s->n + node];
+}
+
+static void init_candidates(LocalSearch *s, int *candidates, bool outgoing) {
+    int n = s->n;
+    for (int node = 0; node < n; node++) {
+        int *list = &candidates[node * CANDIDATES];
+        int count = 0;
+        for (int other = 0; other < n; other++) {
+            int dist = get_weight(s, node, other, outgoing);
+            if (other == node || dist == 0) continue;
+            if (count == CANDIDATES && dist >= get_weight(s, node, list[CANDIDATES - 1], outgoing)) continue;
+            int slot = count < CANDIDATES ? count++ : CANDIDATES - 1;
+            while (slot > 0 && dist < get_weight(s, node, list[slot - 1], outgoing)) {
+                list[slot] = list[slot - 1];
+                slot--;
+            }
+            list[slot] = other;
+        }
+        for (int c = count; c < CANDIDATES; c++) list[c] = -1;
+    }
+}
+
+LocalSearch *local_search_create(const int *edgeMatrix, int n) {
+    LocalSearch *s = malloc(sizeof(LocalSearch));
+    s->edgeMatrix = edgeMatrix;
+    s->n = n;
+    s->symmetric = is_symmetric_matrix(edgeMatrix, n);
+    s->candOut = malloc((size_t) n * CANDIDATES * sizeof(int));
+    s->candIn = malloc((size_t) n * CANDIDATES * sizeof(int));
+    init_candidates(s, s->candOut, true);
+    init_candidates(s, s->candIn, false);
+    s->tour = malloc(n * sizeof(int));
+    s->pos = malloc(n * sizeof(int));
+    s->bestTour = malloc(n * sizeof(int));
+    s->forward = malloc((n + 1) * sizeof(long long));
+    s->backward = malloc((n + 1) * sizeof(long long));
+    s->queue = malloc(n * sizeof(int));
+    s->queued = calloc(n, sizeof(bool));
+    s->queueHead = 0;
+    s->queueCount = 0;
+    s->visited = malloc(n * sizeof(bool));
+    return s;
+}
+
+void local_search_free(LocalSearch *s) {
+    if (s == NULL) return;
+    free(s->candOut);
+    free(s->candIn);
+    free(s->tour);
+    free(s->pos);
+    free(s->bestTour);
+    free(s->forward);
+    free(s->backward);
+    free(s->queue);
+    free(s->queued);
+    free(s->visited);
+    free(s);
+}
+
+static int succ(const LocalSearch *s, int node) {
+    return s->tour[(s->pos[node] + 1) % s->n];
+}
+
+static int pred(const LocalSearch *s, int node) {
+    return s->tour[(s->pos[node] + s->n - 1) % s->n];
+}
+
+static void activate(LocalSearch *s, int node) {
+    if (s->queued[node]) return;
+    s->queued[node] = true;
+    s->queue[(s->queueHead + s->queueCount) % s->n] = node;
+    s->queueCount++;
+}
+
+static int next_active(LocalSearch *s) {
+    int node = s->queue[s->queueHead];
+    s->queueHead = (s->queueHead + 1) % s->n;
+    s->queueCount--;
+    s->queued[node] = false;
+    return node;
+}
+
+static void update_prefix_costs(LocalSearch *s) {
+    if (s->symmetric) return;
+    int n = s->n;
+    s->forward[0] = 0;
+    s->backward[0] = 0;
+    for (int p = 0; p < n; p++) {
+        int from = s->tour[p], to = s->tour[(p + 1) % n];
+        s->forward[p + 1] = s->forward[p] + edge_cost(s, from, to);
+        s->backward[p + 1] = s->backward[p] + edge_cost(s, to, from);
+    }
+}
+
+// cost of the tour edges from position first to position last, wrapping around the end of the array
+static long long get_segment_cost(const long long *prefix, int n, int first, int last) {
+    if (last >= first) return prefix[last] - prefix[first];
+    return prefix[n] - prefix[first] + prefix[last];
+}
+
+// what reversing the nodes from position first to position last changes inside that segment
+static long long get_reversal_delta(const LocalSearch *s, int first, int last) {
+    if (s->symmetric) return 0;
+    return get_segment_cost(s->backward, s->n, first, last) - get_segment_cost(s->forward, s->n, first, last);
+}
+
+static void reverse_positions(LocalSearch *s, int first, int len) {
+    int n = s->n;
+    int a = first, b = (first + len - 1) % n;
+    for (int k = 0; k < len / 2; k++) {
+        int nodeA = s->tour[a], nodeB = s->tour[b];
+        s->tour[a] = nodeB;
+        s->pos[nodeB] = a;
+        s->tour[b] = nodeA;
+        s->pos[nodeA] = b;
+        a = (a + 1) % n;
+        b = (b + n - 1) % n;
+    }
+}
+
+// on a symmetric matrix the rest of the cycle reversed is the same tour, and may be shorter to reverse
+static void reverse_segment(LocalSearch *s, int first, int last) {
+    int n = s->n;
+    int len = (last - first + n) % n + 1;
+    if (s->symmetric && 2 * len > n) {
+        reverse_positions(s, (last + 1) % n, n - len);
+    } else {
+        reverse_positions(s, first, len);
+    }
+    update_prefix_costs(s);
+}
+
+// turns the lenA nodes from position first on followed by lenB nodes into the lenB nodes followed by the lenA ones
+static void swap_blocks(LocalSearch *s, int first, int lenA, int lenB) {
+    reverse_positions(s, first, lenA);
+    reverse_positions(s, (first + lenA) % s->n, lenB);
+    reverse_positions(s, first, lenA + lenB);
+}
+
+/*
+ * 2-opt with a new edge from a to one of its candidates b. Either a and b lose their outgoing tour edges
+ * and succ(a)..b is reversed, or they lose their incoming ones and a..pred(b) is reversed.
+ */
+static bool improve_two_opt(LocalSearch *s, int a) {
+    for (int c = 0; c < CANDIDATES; c++) {
+        int b = s->candOut[a * CANDIDATES + c];
+        if (b < 0) break;
+        long long added = edge_cost(s, a, b);
+        int a1 = succ(s, a), b1 = succ(s, b);
+        if (b != a1 && b1 != a) {
+            long long delta = added + edge_cost(s, a1, b1) - edge_cost(s, a, a1) - edge_cost(s, b, b1)
+                              + get_reversal_delta(s, s->pos[a1], s->pos[b]);
+            if (delta < 0) {
+                reverse_segment(s, s->pos[a1], s->pos[b]);
+                activate(s, a1);
+                activate(s, b);
+                activate(s, b1);
+                return true;
+            }
+        }
+        int a0 = pred(s, a), b0 = pred(s, b);
+        if (b0 != a && b != a0) {
+            long long delta = added + edge_cost(s, a0, b0) - edge_cost(s, a0, a) - edge_cost(s, b0, b)
+                              + get_reversal_delta(s, s->pos[a], s->pos[b0]);
+            if (delta < 0) {
+                reverse_segment(s, s->pos[a], s->pos[b0]);
+                activate(s, a0);
+                activate(s, b);
+                activate(s, b0);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool is_in_segment(const LocalSearch *s, int node, int first, int len) {
+    return (s->pos[node] - s->pos[first] + s->n) % s->n < len;
+}
+
+// moves the len nodes from first to last between x and y = succ(x), rotating whichever side of the cycle is shorter
+static void move_segment(LocalSearch *s, int first, int last, int len, int x, int y) {
+    int n = s->n;
+    int after = succ(s, last), before = pred(s, first);
+    int lenAfter = (s->pos[x] - s->pos[after] + n) % n + 1;
+    int lenBefore = n - len - lenAfter;
+    if (lenAfter <= lenBefore) {
+        swap_blocks(s, s->pos[first], len, lenAfter);
+    } else {
+        swap_blocks(s, s->pos[y], lenBefore, len);
+    }
+    update_prefix_costs(s);
+    activate(s, before);
+    activate(s, after);
+    activate(s, last);
+    activate(s, x);
+    activate(s, y);
+}
+
+// Or-opt: moves the segment of up to OR_OPT_MAX_SEGMENT nodes starting at a next to a candidate, keeping its direction
+static bool improve_or_opt(LocalSearch *s, int a) {
+    int last = a;
+    for (int len = 1; len <= OR_OPT_MAX_SEGMENT && len + 3 <= s->n; len++) {
+        if (len > 1) last = succ(s, last);
+        int before = pred(s, a), after = succ(s, last);
+        long long removeGain = edge_cost(s, before, a) + edge_cost(s, last, after) - edge_cost(s, before, after);
+        if (removeGain <= 0) continue;
+        for (int c = 0; c < CANDIDATES; c++) {
+            // a new edge x -> a from an incoming candidate, or last -> y to an outgoing one
+            int x = s->candIn[a * CANDIDATES + c];
+            if (x >= 0 && x != before && !is_in_segment(s, x, a, len)) {
+                int y = succ(s, x);
+                if (edge_cost(s, x, a) + edge_cost(s, last, y) - edge_cost(s, x, y) < removeGain) {
+                    move_segment(s, a, last, len, x, y);
+                    return true;
+                }
+            }
+            int y = s->candOut[last * CANDIDATES + c];
+            if (y >= 0 && y != after && !is_in_segment(s, y, a, len)) {
+                x = pred(s, y);
+                if (edge_cost(s, x, a) + edge_cost(s, last, y) - edge_cost(s, x, y) < removeGain) {
+                    move_segment(s, a, last, len, x, y);
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static void optimize(LocalSearch *s) {
+    while (s->queueCount > 0) {
+        int a = next_active(s);
+        if (improve_two_opt(s, a) || improve_or_opt(s, a)) activate(s, a);
+    }
+}
+
+static long long get_tour_cost(const LocalSearch *s) {
+    long long cost = 0;
+    for (int p = 0; p < s->n; p++) cost += edge_cost(s, s->tour[p], s->tour[(p + 1) % s->n]);
+    return cost;
+}
+
+// nearest neighbour from a random node, now and then taking the second nearest so that restarts differ
+static void build_tour(LocalSearch *s, unsigned int *seed) {
+    int n = s->n;
+    memset(s->visited, 0, n * sizeof(bool));
+    int curr = (int) (rand_r(seed) % n);
+    for (int p = 0; p < n; p++) {
+        s->tour[p] = curr;
+        s->visited[curr] = true;
+        if (p == n - 1) break;
+        int first = -1, second = -1;
+        for (int c = 0; c < CANDIDATES && second < 0; c++) {
+            int other = s->candOut[curr * CANDIDATES + c];
+            if (other < 0) break;
+            if (s->visited[other]) continue;
+            if (first < 0) first = other;
+            else second = other;
+        }
+        int next = second >= 0 && rand_r(seed) % 4 == 0 ? second : first;
+        if (next < 0) {
+            // every candidate is taken, fall back to a scan of the whole row
+            long long nextCost = LLONG_MAX;
+            for (int other = 0; other < n; other++) {
+                if (s->visited[other] || edge_cost(s, curr, other) >= nextCost) continue;
+                next = other;
+                nextCost = edge_cost(s, curr, other);
+            }
+        }
+        curr = next;
+    }
+}
+
+// A B C D becomes A C B D, a move the local search cannot easily undo, and it reverses nothing
+static void double_bridge(LocalSearch *s, unsigned int *seed) {
+    int n = s->n;
+    int i = 1 + (int) (rand_r(seed) % (n - 3));
+    int j = i + 1 + (int) (rand_r(seed) % (n - i - 2));
+    int k = j + 1 + (int) (rand_r(seed) % (n - j - 1));
+    swap_blocks(s, i, j - i, k - j);
+    update_prefix_costs(s);
+    int ends[] = {i - 1, i, i + k - j - 1, i + k - j, k - 1, k % n};
+    for (int e = 0; e < 6; e++) activate(s, s->tour[ends[e]]);
+}
+
+static void index_tour(LocalSearch *s) {
+    for (int p = 0; p < s->n; p++) s->pos[s->tour[p]] = p;
+    update_prefix_costs(s);
+}
+
+/*
+ * Improves tour, or a new randomized nearest neighbour tour if restart is set, and writes the result
+ * as n + 1 nodes from and back to 0 into tour. Returns its distance, or INT_MAX if it needs a missing edge.
+ */
+int local_search_run(LocalSearch *s, int *tour, bool restart, unsigned int *seed) {
+    int n = s->n;
+    if (n < 2) return INT_MAX;
+    if (restart) {
+        build_tour(s, seed);
+    } else {
+        memcpy(s->tour, tour, n * sizeof(int));
+    }
+    index_tour(s);
+    for (int p = 0; p < n; p++) activate(s, s->tour[p]);
+    optimize(s);
+    long long bestCost = get_tour_cost(s);
+    memcpy(s->bestTour, s->tour, n * sizeof(int));
+    // one kick per node, so the shake covers the whole tour about once per run
+    int kicks = n < MIN_KICKS ? MIN_KICKS : n;
+    for (int kick = 0; n >= 8 && kick < kicks; kick++) {
+        double_bridge(s, seed);
+        optimize(s);
+        long long cost = get_tour_cost(s);
+        if (cost < bestCost) {
+            bestCost = cost;
+            memcpy(s->bestTour, s->tour, n * sizeof(int));
+        } else {
+            memcpy(s->tour, s->bestTour, n * sizeof(int));
+            index_tour(s);
+        }
+    }
+    int start = 0;
+    while (s->bestTour[start] != 0) start++;
+    for (int p = 0; p < n; p++) tour[p] = s->bestTour[(start + p) % n];
+    tour[n] = 0;
+    return bestCost >= INT_MAX ? INT_MAX : (int) bestCost;
+}
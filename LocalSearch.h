@@ -0,0 +1,21 @@
+#ifndef TRAVELINGSALESMAN_LOCALSEARCH_H
+#define TRAVELINGSALESMAN_LOCALSEARCH_H
+
+#include <stdbool.h>
+
+/*
+ * Iterated local search for instances far beyond the exact engines. A run improves a tour with 2-opt moves and
+ * Or-opt segment moves, tried only towards the cheapest neighbours of each node and only around nodes whose
+ * tour edges changed (don't-look bits). Double-bridge kicks then shake the local optimum and keep whatever
+ * improves it. Moves are priced with the directed costs, and missing edges get a prohibitive cost, so
+ * asymmetric and sparse matrices work too.
+ * A LocalSearch holds the buffers for one matrix and is used by one thread at a time.
+ */
+
+typedef struct LocalSearch LocalSearch;
+
+LocalSearch *local_search_create(const int *edgeMatrix, int n);
+void local_search_free(LocalSearch *search);
+int local_search_run(LocalSearch *search, int *tour, bool restart, unsigned int *seed);
+
+#endif //TRAVELINGSALESMAN_LOCALSEARCH_H
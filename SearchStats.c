@@ -0,0 +1,35 @@
+#include <stdio.h>
+#include <string.h>
+#include "SearchStats.h"
+
+static const char *COUNTER_NAMES[STAT_COUNTERS] = {
+        "expanded", "pruned_bound", "pruned_cut", "pruned_symmetry", "pruned_dominance", "pruned_reach",
+        "tours", "no_return", "bound_improvements",
+        "messages", "message_bytes"
+};
+
+static const char *TIMER_NAMES[STAT_TIMERS] = {
+        "search_s", "idle_s", "tail_s"
+};
+
+void reset_stats(SearchStats *stats) {
+    memset(stats, 0, sizeof(SearchStats));
+}
+
+void add_stats(SearchStats *total, const SearchStats *stats) {
+    for (int c = 0; c < STAT_COUNTERS; c++) total->counts[c] += stats->counts[c];
+    for (int t = 0; t < STAT_TIMERS; t++) total->seconds[t] += stats->seconds[t];
+}
+
+long get_pruned(const SearchStats *stats) {
+    return stats->counts[STAT_PRUNED_BOUND] + stats->counts[STAT_PRUNED_CUT] + stats->counts[STAT_PRUNED_SYMMETRY]
+           + stats->counts[STAT_PRUNED_DOMINANCE] + stats->counts[STAT_PRUNED_REACH];
+}
+
+// one JSON object on a line of its own, the times are summed over all searchers
+void print_stats(const SearchStats *total, int searchers) {
+    printf("Stats: {\"searchers\": %d", searchers);
+    for (int c = 0; c < STAT_COUNTERS; c++) printf(", \"%s\": %ld", COUNTER_NAMES[c], total->counts[c]);
+    for (int t = 0; t < STAT_TIMERS; t++) printf(", \"%s\": %.3f", TIMER_NAMES[t], total->seconds[t]);
+    printf("}\n");
+}
@@ -0,0 +1,32 @@
+#ifndef TRAVELINGSALESMAN_SEARCHSTATS_H
+#define TRAVELINGSALESMAN_SEARCHSTATS_H
+
+enum StatCounter {
+    STAT_EXPANDED, STAT_PRUNED_BOUND, STAT_PRUNED_CUT, STAT_PRUNED_SYMMETRY, STAT_PRUNED_DOMINANCE, STAT_PRUNED_REACH,
+    STAT_TOURS, STAT_NO_RETURN, STAT_BOUND_IMPROVEMENTS,
+    STAT_MESSAGES, STAT_MESSAGE_BYTES, STAT_COUNTERS
+};
+
+enum StatTimer {
+    STAT_SEARCH_TIME, STAT_IDLE_TIME, STAT_TAIL_TIME, STAT_TIMERS
+};
+
+/*
+ * Counters every search thread keeps for itself and that are only summed up once the search is over.
+ * Prunes are split by reason: the bound check of a single child, the cut that ends a cheapest-first row,
+ * a child that would only lead to the mirrored orientation of a symmetric tour,
+ * a child the dominance cache knows a shorter path to,
+ * or a path whose unvisited nodes can no longer be closed into a tour.
+ * The tail is the time from the first worker running out of work to the end of the search.
+ */
+typedef struct {
+    long counts[STAT_COUNTERS];
+    double seconds[STAT_TIMERS];
+} SearchStats;
+
+void reset_stats(SearchStats *stats);
+void add_stats(SearchStats *total, const SearchStats *stats);
+long get_pruned(const SearchStats *stats);
+void print_stats(const SearchStats *total, int searchers);
+
+#endif //TRAVELINGSALESMAN_SEARCHSTATS_H
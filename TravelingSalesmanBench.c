@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <omp.h>
+#include "Util.h"
+#include "GraphIO.h"
+
+/*
+ * Benchmark driver behind the tsp_bench target.
+ * It writes fixed instance families into a directory, runs every solver configuration on each of
+ * them through the command line, and prints one CSV or JSON record per run.
+ * Each record carries the wall time, the search time and tail latency the solver reports, nodes expanded and pruned,
+ * and the speedup over the first configuration of the same strategy.
+ * The optimum of the polygon family is known by construction. For the other families,
+ * every run has to agree with the first one.
+ * The solver binaries and the MPI launcher are compiled in by CMake.
+ */
+
+#ifndef BENCH_SEQ_BINARY
+#define BENCH_SEQ_BINARY "./TravelingSalesmanSeq"
+#endif
+#ifndef BENCH_MPI_BINARY
+#define BENCH_MPI_BINARY "./TravelingSalesmanMPI"
+#endif
+#ifndef BENCH_MPIEXEC
+#define BENCH_MPIEXEC "mpiexec"
+#endif
+#ifndef BENCH_MPIEXEC_NUMPROC_FLAG
+#define BENCH_MPIEXEC_NUMPROC_FLAG "-n"
+#endif
+#ifndef BENCH_MPIEXEC_PREFLAGS
+#define BENCH_MPIEXEC_PREFLAGS ""
+#endif
+
+#define ERR_INVALID_ARGS (-1)
+#define ERR_BENCH_FAILED (-4)
+#define PATH_LEN 512
+#define COMMAND_LEN 2048
+#define LINE_LEN 1024
+#define MAX_INSTANCES 32
+#define EUCLID_GRID 1000
+#define POLYGON_RADIUS 1000.0
+#define NO_DISTANCE (-1)
+
+typedef struct {
+    const char *family;
+    char name[64];
+    char file[PATH_LEN];
+    int n;
+    // NO_DISTANCE unless the optimum is known by construction
+    int optimum;
+} Instance;
+
+typedef struct {
+    const char *strategy;
+    bool mpi;
+    int ranks;
+    int threads;
+    const char *args;
+} Config;
+
+typedef struct {
+    bool ok;
+    double wallTime;
+    double searchTime;
+    double tailTime;
+    long expanded;
+    long pruned;
+    int distance;
+} RunResult;
+
+static const struct {
+    int n;
+    int population;
+    unsigned int seed;
+} RANDOM_FAMILY[] = {
+        {10, 30, 1001}, {10, 60, 1002}, {10, 100, 1003},
+        {12, 30, 1201}, {12, 60, 1202}, {12, 100, 1203},
+        {14, 30, 1401}, {14, 60, 1402}, {14, 100, 1403},
+};
+
+static const struct {
+    int n;
+    unsigned int seed;
+} EUCLID_FAMILY[] = {
+        {10, 2001}, {12, 2002}, {14, 2003},
+};
+
+static const int POLYGON_FAMILY[] = {9, 13};
+
+static const Config CONFIGS[] = {
+        {"seq-dfs",       false, 1, 1, ""},
+        {"seq-dfs",       false, 1, 2, "-threads=2"},
+        {"seq-dfs",       false, 1, 4, "-threads=4"},
+        {"seq-dfs-index", false, 1, 1, "-order=index"},
+        {"seq-nocache",   false, 1, 1, "-cache-mb=0"},
+        {"seq-inplace",   false, 1, 1, "-engine=inplace"},
+        {"seq-inplace",   false, 1, 2, "-engine=inplace -threads=2"},
+        {"seq-best",      false, 1, 1, "-engine=best"},
+        {"seq-dp",        false, 1, 1, "-engine=dp"},
+        {"mpi-manager",   true,  2, 1, ""},
+        {"mpi-manager",   true,  4, 1, ""},
+        {"mpi-steal",     true,  2, 1, "-steal"},
+        {"mpi-steal",     true,  4, 1, "-steal"},
+        {"mpi-inplace",   true,  2, 1, "-steal -engine=inplace"},
+        {"mpi-hybrid",    true,  2, 2, "-threads=2"},
+};
+#define N_CONFIGS (int) (sizeof(CONFIGS) / sizeof(CONFIGS[0]))
+
+bool json = false;
+FILE *out;
+bool firstRecord = true;
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool write_random_instance(Instance *instance, const char *dir, int n, int population, unsigned int seed) {
+    instance->family = "random";
+    snprintf(instance->name, sizeof(instance->name), "random-n%d-p%d-s%u", n, population, seed);
+    snprintf(instance->file, PATH_LEN, "%s/%s.bin", dir, instance->name);
+    instance->n = n;
+    instance->optimum = NO_DISTANCE;
+    int *edgeMatrix = get_seeded_edge_matrix(n, population, seed, omp_get_max_threads());
+    bool ok = write_binary_matrix(instance->file, edgeMatrix, n);
+    free(edgeMatrix);
+    return ok;
+}
+
+static bool write_coordinates(Instance *instance, const double *x, const double *y) {
+    FILE *file = fopen(instance->file, "w");
+    if (file == NULL) {
+        printf("Could not create %s!\n", instance->file);
+        return false;
+    }
+    fprintf(file, "NAME : %s\nTYPE : TSP\nDIMENSION : %d\nEDGE_WEIGHT_TYPE : EUC_2D\nNODE_COORD_SECTION\n",
+            instance->name, instance->n);
+    for (int i = 0; i < instance->n; i++) fprintf(file, "%d %.3f %.3f\n", i + 1, x[i], y[i]);
+    fprintf(file, "EOF\n");
+    return fclose(file) == 0;
+}
+
+static bool write_euclid_instance(Instance *instance, const char *dir, int n, unsigned int seed) {
+    instance->family = "euclid";
+    snprintf(instance->name, sizeof(instance->name), "euclid-n%d-s%u", n, seed);
+    snprintf(instance->file, PATH_LEN, "%s/%s.tsp", dir, instance->name);
+    instance->n = n;
+    instance->optimum = NO_DISTANCE;
+    double x[n], y[n];
+    for (int i = 0; i < n; i++) {
+        x[i] = rand_r(&seed) % EUCLID_GRID;
+        y[i] = rand_r(&seed) % EUCLID_GRID;
+    }
+    return write_coordinates(instance, x, y);
+}
+
+/*
+ * Nodes on a circle: the optimal tour follows the circle, since any other tour crosses itself.
+ * The optimum is summed from the coordinates as written, with TSPLIB rounding.
+ */
+static bool write_polygon_instance(Instance *instance, const char *dir, int n) {
+    instance->family = "polygon";
+    snprintf(instance->name, sizeof(instance->name), "polygon-n%d", n);
+    snprintf(instance->file, PATH_LEN, "%s/%s.tsp", dir, instance->name);
+    instance->n = n;
+    double x[n], y[n];
+    for (int i = 0; i < n; i++) {
+        x[i] = round(POLYGON_RADIUS * cos(2 * M_PI * i / n) * 1000) / 1000;
+        y[i] = round(POLYGON_RADIUS * sin(2 * M_PI * i / n) * 1000) / 1000;
+    }
+    instance->optimum = 0;
+    for (int i = 0; i < n; i++) {
+        int j = (i + 1) % n;
+        instance->optimum += (int) lround(sqrt((x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j])));
+    }
+    return write_coordinates(instance, x, y);
+}
+
+static int write_instances(Instance *instances, const char *dir) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        printf("Could not create instance directory %s!\n", dir);
+        return -1;
+    }
+    int count = 0;
+    for (size_t r = 0; r < sizeof(RANDOM_FAMILY) / sizeof(RANDOM_FAMILY[0]); r++) {
+        if (!write_random_instance(&instances[count++], dir, RANDOM_FAMILY[r].n, RANDOM_FAMILY[r].population,
+                                   RANDOM_FAMILY[r].seed)) return -1;
+    }
+    for (size_t e = 0; e < sizeof(EUCLID_FAMILY) / sizeof(EUCLID_FAMILY[0]); e++) {
+        if (!write_euclid_instance(&instances[count++], dir, EUCLID_FAMILY[e].n, EUCLID_FAMILY[e].seed)) return -1;
+    }
+    for (size_t p = 0; p < sizeof(POLYGON_FAMILY) / sizeof(POLYGON_FAMILY[0]); p++) {
+        if (!write_polygon_instance(&instances[count++], dir, POLYGON_FAMILY[p])) return -1;
+    }
+    return count;
+}
+
+// the distance follows the last comma of the line after "Best path:", with or without a rank prefix
+static void parse_line(const char *line, bool afterBestPath, RunResult *result) {
+    double seconds;
+    long expanded, pruned;
+    const char *tail = strstr(line, "\"tail_s\": ");
+    if (sscanf(line, "Algorithm took %lfs", &seconds) == 1) {
+        result->searchTime = seconds;
+    } else if (strncmp(line, "Stats: ", 7) == 0 && tail != NULL) {
+        result->tailTime = strtod(tail + 10, NULL);
+    } else if (sscanf(line, "Expanded %ld nodes, pruned %ld", &expanded, &pruned) == 2) {
+        result->expanded = expanded;
+        result->pruned = pruned;
+    } else if (strncmp(line, "No solution possible", 20) == 0) {
+        result->distance = INT_MAX;
+    } else if (afterBestPath) {
+        const char *comma = strrchr(line, ',');
+        if (comma != NULL) result->distance = (int) strtol(comma + 1, NULL, 10);
+    }
+}
+
+static RunResult run(const Config *config, const Instance *instance) {
+    char command[COMMAND_LEN];
+    if (config->mpi) {
+        snprintf(command, COMMAND_LEN, "%s %s %d %s \"%s\" file \"%s\" %s 2>&1", BENCH_MPIEXEC,
+                 BENCH_MPIEXEC_NUMPROC_FLAG, config->ranks, BENCH_MPIEXEC_PREFLAGS, BENCH_MPI_BINARY,
+                 instance->file, config->args);
+    } else {
+        snprintf(command, COMMAND_LEN, "\"%s\" file \"%s\" %s 2>&1", BENCH_SEQ_BINARY, instance->file, config->args);
+    }
+    RunResult result = {false, 0, -1, 0, -1, -1, NO_DISTANCE};
+    double t = now();
+    FILE *pipe = popen(command, "r");
+    if (pipe == NULL) return result;
+    char line[LINE_LEN];
+    bool afterBestPath = false;
+    while (fgets(line, LINE_LEN, pipe) != NULL) {
+        if (line[0] == '\n') continue;
+        parse_line(line, afterBestPath, &result);
+        afterBestPath = strncmp(line, "Best path:", 10) == 0;
+    }
+    int status = pclose(pipe);
+    result.wallTime = now() - t;
+    // "no solution" exits with -1, which is a valid outcome as long as it is reported
+    result.ok = status != -1 && WIFEXITED(status) && (WEXITSTATUS(status) == 0 || result.distance == INT_MAX);
+    return result;
+}
+
+static const char *get_status(const RunResult *result, const Instance *instance, int reference) {
+    if (!result->ok || result->distance == NO_DISTANCE) return "failed";
+    if (instance->optimum != NO_DISTANCE && result->distance != instance->optimum) return "wrong";
+    if (reference != NO_DISTANCE && result->distance != reference) return "wrong";
+    return "ok";
+}
+
+static void print_record(const Instance *instance, const Config *config, const RunResult *result,
+                         const char *status, double speedup) {
+    int distance = result->distance == INT_MAX ? NO_DISTANCE : result->distance;
+    if (json) {
+        fprintf(out, "%s\n  {\"family\": \"%s\", \"instance\": \"%s\", \"n\": %d, \"strategy\": \"%s\", "
+                     "\"ranks\": %d, \"threads\": %d, \"args\": \"%s\", \"wall_s\": %.3f, \"search_s\": %.3f, "
+                     "\"tail_s\": %.3f, \"expanded\": %ld, \"pruned\": %ld, \"distance\": %d, \"optimum\": %d, "
+                     "\"speedup\": %.2f, \"status\": \"%s\"}",
+                firstRecord ? "" : ",", instance->family, instance->name, instance->n, config->strategy,
+                config->ranks, config->threads, config->args, result->wallTime, result->searchTime,
+                result->tailTime, result->expanded, result->pruned, distance, instance->optimum, speedup, status);
+    } else {
+        fprintf(out, "%s,%s,%d,%s,%d,%d,%s,%.3f,%.3f,%.3f,%ld,%ld,%d,%d,%.2f,%s\n", instance->family, instance->name,
+                instance->n, config->strategy, config->ranks, config->threads, config->args, result->wallTime,
+                result->searchTime, result->tailTime, result->expanded, result->pruned, distance, instance->optimum,
+                speedup, status);
+    }
+    fflush(out);
+    firstRecord = false;
+}
+
+// returns the number of runs that failed or disagreed with the optimum or the first run
+static int run_instance(const Instance *instance) {
+    int failures = 0;
+    int reference = NO_DISTANCE;
+    RunResult results[N_CONFIGS];
+    for (int c = 0; c < N_CONFIGS; c++) {
+        results[c] = run(&CONFIGS[c], instance);
+        const char *status = get_status(&results[c], instance, reference);
+        if (strcmp(status, "ok") != 0) failures++;
+        if (reference == NO_DISTANCE && strcmp(status, "ok") == 0) reference = results[c].distance;
+        // the first configuration of a strategy is its baseline
+        int base = c;
+        while (base > 0 && strcmp(CONFIGS[base - 1].strategy, CONFIGS[c].strategy) == 0) base--;
+        double speedup = results[base].searchTime > 0 && results[c].searchTime > 0
+                         ? results[base].searchTime / results[c].searchTime : 1.0;
+        print_record(instance, &CONFIGS[c], &results[c], status, speedup);
+    }
+    return failures;
+}
+
+bool parse_args(int argc, char *argv[], char **instanceDir, char **outFile) {
+    if (argc < 2) {
+        printf("Not enough arguments!\n");
+        printf("Usage: <program> <instance directory> [-json] [-out=<file>]\n");
+        return false;
+    }
+    *instanceDir = argv[1];
+    *outFile = NULL;
+    for (int a = 2; a < argc; a++) {
+        if (strcmp(argv[a], "-json") == 0) {
+            json = true;
+        } else if (strncmp(argv[a], "-out=", 5) == 0) {
+            *outFile = argv[a] + 5;
+        } else {
+            printf("Unknown argument '%s'!\n", argv[a]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    char *instanceDir, *outFile;
+    if (!parse_args(argc, argv, &instanceDir, &outFile)) return ERR_INVALID_ARGS;
+    Instance instances[MAX_INSTANCES];
+    int nInstances = write_instances(instances, instanceDir);
+    if (nInstances < 0) return ERR_BENCH_FAILED;
+    out = outFile == NULL ? stdout : fopen(outFile, "w");
+    if (out == NULL) {
+        printf("Could not create %s!\n", outFile);
+        return ERR_BENCH_FAILED;
+    }
+    if (json) {
+        fprintf(out, "[");
+    } else {
+        fprintf(out, "family,instance,n,strategy,ranks,threads,args,wall_s,search_s,tail_s,expanded,pruned,"
+                     "distance,optimum,speedup,status\n");
+    }
+    int failures = 0;
+    for (int i = 0; i < nInstances; i++) {
+        if (out != stdout) printf("%s\n", instances[i].name);
+        failures += run_instance(&instances[i]);
+    }
+    if (json) fprintf(out, "\n]\n");
+    if (out != stdout) fclose(out);
+    if (failures > 0) {
+        printf("%d runs failed or disagreed on the tour length!\n", failures);
+        return ERR_BENCH_FAILED;
+    }
+    return 0;
+}
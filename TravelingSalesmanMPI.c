@@ -4,53 +4,176 @@
 #include <limits.h>
 #include <mpi.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sched.h>
 #include <time.h>
+#include <omp.h>
 #include "Util.h"
+#include "EdgeLayout.h"
+#include "GraphIO.h"
+#include "SearchStats.h"
+#include "TspEngine.h"
+#include "LocalSearch.h"
+#include "GraphReduction.h"
 
 bool parse_args(int argc, char **argv);
+bool share_edge_matrix();
+int solve_batch();
+int solve_local_search();
 void init_globals();
-int get_path_length(int *p);
-void set_path_length(int *p, int len);
-int get_path_dist(int *p);
-void set_path_dist(int *p, int dist);
-int get_last_node(int *path);
-int *init_path();
-bool is_already_in_path(int *path, int node);
-void add_path(int *path);
-void remove_path(int *path);
+void lower_open_bound(int bound);
+bool parse_bound_mode(char *arg);
+void warm_start();
 void split_work(int *path);
-void solve(int *path);
-int add_node(int *path, int i);
-void remove_node(int *path, int w);
-void update_result(int *path);
-int *get_path_from_manager();
-void send_path_to_worker(int *path, int dest);
-void listen_for_messages();
+void solve();
+bool parse_engine(char *arg);
+void count_limit_nodes();
+bool check_limits();
+bool parse_child_order(char *arg);
+void report_best(int distance);
+void publish_improvement(int distance);
+void request_packet();
+bool receive_packet(bool wait);
+void send_packet_to_worker(int dest);
+void pre_split_work();
+void ensure_work_available();
+void record_subtree_cost(long nodes, int subtrees, long estimate);
+void update_subtree_cost(int cost, int estimate);
+int estimate_subtree_cost(int *path);
+void order_frontier(int from);
+int compare_estimates(const void *a, const void *b);
+double get_predicted_cost(int *path);
+int get_packet_size();
+void serve_workers();
+void handle_request(int worker, int *request);
 bool get_done_flag(int *buf);
 void set_best_dist(int *buf, int distance);
 void set_done_flag(int *buf, int flag);
 int get_best_dist(int *buf);
+int get_packet_count(int *buf);
+void set_packet_count(int *buf, int count);
+int *get_packet_path(int *buf, int index);
 bool all_threads_terminated();
 void send_done_to_worker(int dest);
-void send_result_to_manager();
 void freeGlobals();
-void send_beset_distance_to_worker(int dest);
+void count_message(int ints);
+void reduce_stats(double elapsed, SearchStats *total, double *maxIdle);
+void run_work_stealing();
+void handle_steal_message(MPI_Status *status);
+void send_steal_request();
+void answer_steal_request(int thief);
+void receive_stolen_paths(int source);
+void pass_token();
+void finish_work_stealing();
+void collect_best_path();
+void init_best_distance_window();
+void free_best_distance_window();
+void publish_best_distance(int distance);
+void refresh_best_distance();
+void poll_manager();
+void run_hybrid_worker();
+void refill_local_queue(bool wait);
+void push_local_queue(int *path);
+bool pop_local_queue(int *path);
 
-bool prune = true;
+enum GraphSource {
+    GRAPH_EXAMPLE, GRAPH_RANDOM, GRAPH_FILE, GRAPH_BATCH
+};
+
+enum Engine {
+    ENGINE_DFS, ENGINE_INPLACE, ENGINE_ILS
+};
+
+/*
+ * The search itself is the engine of TspEngine.h: the instance and the best tour of this rank live in problem,
+ * and every search thread runs its own search on it, with its own stack, dominance cache and counters.
+ * Each rank splits its cache evenly between its search threads. Packets and stolen paths are path records of
+ * the engine and carry the assignment block of -bound=ap along, Knuth probes only use the partial bound.
+ */
+TspOptions options;
+TspProblem problem;
+_Thread_local TspSearch search;
+enum Engine engine = ENGINE_DFS;
 bool verbose = false;
+bool workStealing = false;
+int threadsPerRank = 1;
+int splitDepth = 1;
+enum GraphSource graphSource;
+char *graphFile;
+int randomNodes;
+int randomPopulation;
+// local search restarts of -engine=ils over all ranks, 0 runs them until the time limit
+int restarts = 8;
 
 int N;
 int *edgeMatrix;
-int bestDistance;
-int *bestPath;
-int *paths;
-int pathsInStack;
+// node-local shared memory holding edgeMatrix, written once by the first rank of each node
+MPI_Win edgeMatrixWin;
+/*
+ * Graph preprocessing: the manager drops the edges no tour can use before sharing the matrix, and every rank stops
+ * right away if there is no tour at all (hasTour), -noreduce skips it.
+ */
+bool hasTour = true;
+/*
+ * Anytime mode: the search stops once options.timeLimit seconds or options.nodeLimit expansions over all ranks
+ * are used up (0 is unlimited). Whichever rank reaches a limit raises the stop flag in the shared window, the
+ * others see it at their next poll. The open paths left behind bound every tour not yet seen, so
+ * min(openBound, bestDistance) over all ranks is a proven lower bound on the optimum.
+ */
+double startTime;
+_Atomic bool stopRequested;
+// expansions of this rank not yet added to the shared count
+_Atomic long unreportedNodes;
+_Thread_local long countedNodes;
+int openBound = INT_MAX;
 
 int nThreads, rank;
 int *commBuffer;
 int commBufferSize;
-int doneFlag;
+_Atomic int doneFlag;
 int workerThreadsTerminated;
+// manager: moving average of the nodes workers really expand per estimated node, negative until the first report
+double costPerEstimate;
+unsigned int probeSeed;
+int *probePath;
+int *probeChildren;
+// manager: when the first worker was told that no work is left, the tail ends when the last one is
+double firstDoneTime;
+// worker: subtree cost and its estimate accumulated since the last request
+_Atomic long solvedSubtreeNodes;
+_Atomic long solvedSubtreeEstimate;
+_Atomic int solvedSubtrees;
+// worker: the next packet is prefetched into commBuffer while the current one is searched
+int *requestBuffer;
+MPI_Request packetSendRequest;
+MPI_Request packetRecvRequest;
+bool packetPending;
+
+int *stealBuffer;
+int stealBufferSize;
+bool stealOutstanding;
+unsigned int stealSeed;
+// Dijkstra-Safra termination detection state
+int safraCounter;
+bool safraBlack;
+bool holdingToken;
+bool tokenReturned;
+int token[2];
+// global best distance and anytime-mode state, hosted by the manager and accessed through atomic RMA operations
+typedef struct {
+    int bestDistance;
+    int stopFlag;
+    long expandedNodes;
+} SharedState;
+
+MPI_Win bestDistanceWin;
+SharedState *sharedState;
+int publishedBestDistance;
+// hybrid mode: subtrees fetched from the manager, shared by the search threads of this rank
+int *localQueue;
+int localQueueCount;
+omp_lock_t localQueueLock;
 
 static const int EXAMPLE_EDGES[][4] = {
         {0, 1,  3,  8},
@@ -60,70 +183,214 @@ static const int EXAMPLE_EDGES[][4] = {
 };
 #define EXAMPLE_N_NODES 4
 #define ERR_INVALID_ARGS (-1)
-#define OFFSET_PATH_LEN 1
-#define OFFSET_PATH_DIST 2
 #define MANAGER 0
-#define OFFSET_BEST_DIST 3
-#define OFFSET_DONE_FLAG 4
+/*
+ * commBuffer holds a packet: a header followed by up to PACKET_MAX_PATHS path records.
+ * Requests from workers carry only the header, reporting the average cost of their last subtrees
+ * and the average estimate the manager had made for them.
+ */
+#define OFFSET_PACKET_COUNT 0
+#define OFFSET_BEST_DIST 1
+#define OFFSET_DONE_FLAG 2
+#define OFFSET_SUBTREE_COST 3
+#define OFFSET_SUBTREE_ESTIMATE 4
+#define PACKET_HEADER_SIZE 5
+#define PACKET_MAX_PATHS 16
+// nodes one packet should keep a worker busy for, subtrees predicted above that get split further
+#define TARGET_PACKET_NODES 100000
+#define COST_SMOOTHING 0.2
+// random dives per estimate, and how many open paths per worker the manager splits up to
+#define PROBE_COUNT 16
+#define FRONTIER_PER_WORKER 32
+// header of a steal reply, followed by the donated path records
+#define OFFSET_STEAL_COUNT 0
+#define OFFSET_STEAL_BEST_DIST 1
+#define STEAL_HEADER_SIZE 2
+#define STEAL_MAX_PATHS 8
+// extra stack room of a search for the paths it receives in one packet or steal reply
+#define ROOT_PATHS (STEAL_MAX_PATHS > PACKET_MAX_PATHS ? STEAL_MAX_PATHS : PACKET_MAX_PATHS)
+#define STEAL_POLL_INTERVAL 1024
+#define BOUND_POLL_INTERVAL 4096
+#define TOKEN_COUNT 0
+#define TOKEN_BLACK 1
 
 static const int TAG_REQUEST_PATH = 97;
 static const int TAG_NEW_BEST = 98;
-static const int TAG_BEST_DIST = 99;
+static const int TAG_STEAL_REQUEST = 100;
+static const int TAG_STEAL_REPLY = 101;
+static const int TAG_TOKEN = 102;
+static const int TAG_DONE = 103;
 
 int main(int argc, char *argv[]) {
-    if (!parse_args(argc, argv)) return ERR_INVALID_ARGS;
-    MPI_Init(&argc, &argv);
+    int threadSupport;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &threadSupport);
     MPI_Comm_size(MPI_COMM_WORLD, &nThreads);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (!parse_args(argc, argv)) {
+        MPI_Finalize();
+        return ERR_INVALID_ARGS;
+    }
+    if (graphSource == GRAPH_BATCH) {
+        int status = solve_batch();
+        MPI_Finalize();
+        return status;
+    }
+    if (!share_edge_matrix()) {
+        MPI_Finalize();
+        return ERR_INVALID_ARGS;
+    }
+    if (!hasTour) {
+        if (rank == 0) printf("No solution possible for current graph!\n");
+        MPI_Win_free(&edgeMatrixWin);
+        MPI_Finalize();
+        return -1;
+    }
+    if (engine == ENGINE_ILS) {
+        int status = solve_local_search();
+        MPI_Win_free(&edgeMatrixWin);
+        MPI_Finalize();
+        return status;
+    }
+    if (threadSupport < MPI_THREAD_FUNNELED && threadsPerRank > 1) {
+        logt_msg(true, rank, "MPI library lacks MPI_THREAD_FUNNELED support, using a single thread.");
+        threadsPerRank = 1;
+    }
+    if (nThreads == 1 && !workStealing) {
+        // a lone manager has no workers to hand subtrees to, the stealing loop searches on its own
+        logt_msg(threadsPerRank > 1, rank, "single rank, searching without the manager and with one thread.");
+        workStealing = true;
+        threadsPerRank = 1;
+    }
     if (rank == 0) {
         print_edge_matrix(&edgeMatrix, N);
     }
     init_globals();
     double t = MPI_Wtime();
-    if (rank == 0) {
-        int *path = init_path();
-        add_path(path);
-        free(path);
-        while (true) {
-            listen_for_messages();
-            if (all_threads_terminated()) break;
-        }
+    startTime = t;
+    if (workStealing) {
+        run_work_stealing();
+    } else if (rank == 0) {
+        if (options.warmStart) warm_start();
+        pre_split_work();
+        serve_workers();
+        if (stopRequested) lower_open_bound(tsp_get_search_open_bound(&search));
+    } else if (threadsPerRank > 1) {
+        run_hybrid_worker();
     } else {
+        request_packet();
         while (true) {
-            int *path = get_path_from_manager();
+            receive_packet(true);
             if (doneFlag) break;
-            solve(path);
+            int count = get_packet_count(commBuffer);
+            if (stopRequested) {
+                // a packet that crossed the stop is only bounded, the manager answers the next request with done
+                lower_open_bound(tsp_get_open_bound(&problem, get_packet_path(commBuffer, 0), count));
+                request_packet();
+                continue;
+            }
+            long expandedBefore = search.stats.counts[STAT_EXPANDED];
+            long estimate = 0;
+            for (int p = 0; p < count; p++) {
+                tsp_push_path(&search, get_packet_path(commBuffer, p));
+                estimate += tsp_get_path_estimate(&problem, get_packet_path(commBuffer, p));
+            }
+            // the packet now lives on the stack, so commBuffer can already receive the next one
+            request_packet();
+            solve();
+            record_subtree_cost(search.stats.counts[STAT_EXPANDED] - expandedBefore, count, estimate);
         }
+        if (stopRequested) lower_open_bound(tsp_get_search_open_bound(&search));
     }
+    collect_best_path();
     t = MPI_Wtime() - t;
-    if (rank == 0) {
-        if (bestDistance == INT_MAX) {
-            printf("No solution possible for current graph!\n");
-            MPI_Finalize();
-            return -1;
-        }
+    free_best_distance_window();
+    SearchStats total;
+    double maxIdle;
+    reduce_stats(t, &total, &maxIdle);
+    int stoppedHere = stopRequested, stopped, lowerBound;
+    MPI_Reduce(&stoppedHere, &stopped, 1, MPI_INT, MPI_MAX, MANAGER, MPI_COMM_WORLD);
+    MPI_Reduce(&openBound, &lowerBound, 1, MPI_INT, MPI_MIN, MANAGER, MPI_COMM_WORLD);
+    int status = 0;
+    int bestDistance = problem.bestDistance;
+    if (rank == 0 && bestDistance == INT_MAX) {
+        // the other ranks already wait in the collective window frees of freeGlobals
+        printf(stopped ? "No tour found before the search limit!\n" : "No solution possible for current graph!\n");
+        status = -1;
+    } else if (rank == 0) {
         printf("\nBest path:\n");
-        printt_path(true, rank, bestPath, N + 1, bestDistance);
+        printt_path(true, rank, problem.bestPath, N + 1, bestDistance);
         printf("\nAlgorithm took %.3fs\n", t);
+        if (stopped) {
+            if (bestDistance < lowerBound) lowerBound = bestDistance;
+            printf("Stopped at the search limit, lower bound %d, optimality gap %.2f%%\n",
+                   lowerBound, 100.0 * (bestDistance - lowerBound) / bestDistance);
+        }
+        int searchingRanks = workStealing || nThreads == 1 ? nThreads : nThreads - 1;
+        printf("Expanded %ld nodes, pruned %ld\n", total.counts[STAT_EXPANDED], get_pruned(&total));
+        printf("Idle time per rank: avg %.3fs, max %.3fs, tail %.3fs\n", total.seconds[STAT_IDLE_TIME] / searchingRanks,
+               maxIdle, total.seconds[STAT_TAIL_TIME]);
+        print_stats(&total, searchingRanks * threadsPerRank);
     } else {
         logt_msg(true, rank, "thread exiting...");
     }
     freeGlobals();
     MPI_Finalize();
-    return 0;
+    return status;
+}
+
+/*
+ * Sums the counters of all ranks into total on the manager. The manager only waits in the protocol
+ * modes, so there its time is left out of the idle and search statistics.
+ */
+void reduce_stats(double elapsed, SearchStats *total, double *maxIdle) {
+    if (rank != MANAGER || workStealing || nThreads == 1 || engine == ENGINE_ILS) {
+        search.stats.seconds[STAT_SEARCH_TIME] = elapsed - search.stats.seconds[STAT_IDLE_TIME];
+    } else {
+        search.stats.seconds[STAT_IDLE_TIME] = 0;
+    }
+    MPI_Reduce(search.stats.counts, total->counts, STAT_COUNTERS, MPI_LONG, MPI_SUM, MANAGER, MPI_COMM_WORLD);
+    MPI_Reduce(search.stats.seconds, total->seconds, STAT_TIMERS, MPI_DOUBLE, MPI_SUM, MANAGER, MPI_COMM_WORLD);
+    MPI_Reduce(&search.stats.seconds[STAT_IDLE_TIME], maxIdle, 1, MPI_DOUBLE, MPI_MAX, MANAGER, MPI_COMM_WORLD);
+}
+
+void count_message(int ints) {
+    search.stats.counts[STAT_MESSAGES]++;
+    search.stats.counts[STAT_MESSAGE_BYTES] += ints * (long) sizeof(int);
 }
 
 void init_globals() {
-    allocate_int_array(&paths, N * (N - 1) / 2, N + 3);
-    pathsInStack = 0;
-    allocate_int_array(&bestPath, 1, N + 3);
-    bestDistance = INT_MAX;
-    commBufferSize = N + 5;
+    tsp_init_problem(&problem, edgeMatrix, N, &options);
+    problem.reportBest = publish_improvement;
+    problem.verbose = verbose;
+    problem.rank = rank;
+    tsp_init_search(&search, &problem, ROOT_PATHS, threadsPerRank);
+    int pathSize = problem.pathSize;
+    commBufferSize = PACKET_HEADER_SIZE + PACKET_MAX_PATHS * pathSize;
     allocate_int_array(&commBuffer, 1, commBufferSize);
+    set_packet_count(commBuffer, 0);
     doneFlag = false;
     if (rank == 0) {
         workerThreadsTerminated = 0;
     }
+    costPerEstimate = -1;
+    probeSeed = 7;
+    allocate_int_array(&probePath, 1, pathSize);
+    allocate_int_array(&probeChildren, 1, N);
+    solvedSubtreeNodes = 0;
+    solvedSubtreeEstimate = 0;
+    solvedSubtrees = 0;
+    allocate_int_array(&requestBuffer, 1, PACKET_HEADER_SIZE);
+    packetPending = false;
+    stealBufferSize = STEAL_HEADER_SIZE + STEAL_MAX_PATHS * pathSize;
+    allocate_int_array(&stealBuffer, 1, stealBufferSize);
+    init_best_distance_window();
+    publishedBestDistance = INT_MAX;
+    stealOutstanding = false;
+    stealSeed = 42 + rank;
+    safraCounter = 0;
+    safraBlack = false;
+    holdingToken = rank == 0;
+    tokenReturned = false;
 }
 
 bool all_threads_terminated() {
@@ -131,266 +398,1050 @@ bool all_threads_terminated() {
 }
 
 void freeGlobals() {
-    free(paths);
-    free(bestPath);
     free(commBuffer);
+    free(stealBuffer);
+    free(requestBuffer);
+    free(probePath);
+    free(probeChildren);
+    tsp_free_search(&search);
+    tsp_free_problem(&problem);
+    MPI_Win_free(&edgeMatrixWin);
 }
 
-void listen_for_messages() {
-    MPI_Status status;
-    logt_msg(verbose, rank, "waiting for requests from workers...");
-    MPI_Recv(commBuffer, commBufferSize, MPI_INT,
-             MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-    if (status.MPI_TAG == TAG_REQUEST_PATH) {
-        logt_msg(verbose, rank, "received request was for a new path...");
-        if (doneFlag) {
-            send_done_to_worker(status.MPI_SOURCE);
-            workerThreadsTerminated++;
-        } else {
-            int *path = commBuffer;
-            remove_path(path);
-            if (pathsInStack == 0) {
-                split_work(path);
-                if (pathsInStack > 1) {
-                    remove_path(path);
-                }
-            }
-            send_path_to_worker(path, status.MPI_SOURCE);
-            if (pathsInStack == 0) {
-                doneFlag = true;
-            }
-        }
-    } else if (status.MPI_TAG == TAG_NEW_BEST) {
-        logt_msg(verbose, rank, "received request was for a new best score...");
-        int newDist = get_best_dist(commBuffer);
-        logt_curr_best_dist(verbose, rank, newDist, bestDistance);
-        if (newDist < bestDistance) {
-            logt_msg(verbose, rank, "new best. copying to bestPath...");
-            memcpy(bestPath, commBuffer, (N + 3) * sizeof(int));
-            bestDistance = newDist;
+/*
+ * The manager keeps one receive posted per worker and serves whichever request completes first.
+ * A worker's receive is not reposted once it was told that the work is done.
+ */
+void serve_workers() {
+    int workers = nThreads - 1;
+    int *requests;
+    allocate_int_array(&requests, workers, PACKET_HEADER_SIZE);
+    MPI_Request *pending = malloc(workers * sizeof(MPI_Request));
+    for (int w = 0; w < workers; w++) {
+        MPI_Irecv(&requests[w * PACKET_HEADER_SIZE], PACKET_HEADER_SIZE, MPI_INT,
+                  w + 1, TAG_REQUEST_PATH, MPI_COMM_WORLD, &pending[w]);
+    }
+    firstDoneTime = -1;
+    while (!all_threads_terminated()) {
+        int index;
+        LOG_INFO(logt_msg(verbose, rank, "waiting for requests from workers..."));
+        MPI_Waitany(workers, pending, &index, MPI_STATUS_IGNORE);
+        int terminatedBefore = workerThreadsTerminated;
+        handle_request(index + 1, &requests[index * PACKET_HEADER_SIZE]);
+        if (workerThreadsTerminated == terminatedBefore) {
+            MPI_Irecv(&requests[index * PACKET_HEADER_SIZE], PACKET_HEADER_SIZE, MPI_INT,
+                      index + 1, TAG_REQUEST_PATH, MPI_COMM_WORLD, &pending[index]);
         }
-        send_beset_distance_to_worker(status.MPI_SOURCE);
+    }
+    if (firstDoneTime >= 0) search.stats.seconds[STAT_TAIL_TIME] = MPI_Wtime() - firstDoneTime;
+    free(pending);
+    free(requests);
+}
+
+void handle_request(int worker, int *request) {
+    LOG_INFO(logt_msg(verbose, rank, "received request was for a new path..."));
+    update_subtree_cost(request[OFFSET_SUBTREE_COST], request[OFFSET_SUBTREE_ESTIMATE]);
+    if (!doneFlag) {
+        refresh_best_distance();
+        ensure_work_available();
+        if (search.pathsInStack == 0 || check_limits()) doneFlag = true;
+    }
+    if (doneFlag) {
+        if (firstDoneTime < 0) firstDoneTime = MPI_Wtime();
+        send_done_to_worker(worker);
+        workerThreadsTerminated++;
     } else {
-        logt_msg(verbose, rank, "unknown tag received!");
+        send_packet_to_worker(worker);
     }
 }
 
 void send_done_to_worker(int dest) {
-    logt_msg(verbose, rank, "informing worker that work is done.");
-    set_best_dist(commBuffer, bestDistance);
+    LOG_INFO(logt_msg(verbose, rank, "informing worker that work is done."));
+    set_packet_count(commBuffer, 0);
+    set_best_dist(commBuffer, problem.bestDistance);
     set_done_flag(commBuffer, doneFlag);
-    MPI_Send(commBuffer, commBufferSize, MPI_INT,
+    MPI_Send(commBuffer, PACKET_HEADER_SIZE, MPI_INT,
              dest, TAG_REQUEST_PATH, MPI_COMM_WORLD);
+    count_message(PACKET_HEADER_SIZE);
 }
 
-void send_path_to_worker(int *path, int dest) {
-    logt_msg(verbose, rank, "sending path to worker...");
-    printt_path(verbose, rank, path, get_path_length(path), get_path_dist(path));
-    set_best_dist(commBuffer, bestDistance);
+void send_packet_to_worker(int dest) {
+    int count = get_packet_size();
+    LOG_INFO(logt_msg(verbose, rank, "sending packet to worker..."));
+    for (int p = 0; p < count; p++) {
+        int *path = get_packet_path(commBuffer, p);
+        tsp_pop_path(&search, path);
+        LOG_TRACE(printt_path(verbose, rank, path, tsp_get_path_length(&problem, path), tsp_get_path_dist(&problem, path)));
+    }
+    set_packet_count(commBuffer, count);
+    set_best_dist(commBuffer, problem.bestDistance);
     set_done_flag(commBuffer, doneFlag);
-    MPI_Send(commBuffer, commBufferSize, MPI_INT,
+    MPI_Send(commBuffer, PACKET_HEADER_SIZE + count * problem.pathSize, MPI_INT,
              dest, TAG_REQUEST_PATH, MPI_COMM_WORLD);
+    count_message(PACKET_HEADER_SIZE + count * problem.pathSize);
 }
 
-void send_beset_distance_to_worker(int dest) {
-    logt_msg(verbose, rank, "sending back best distance by now...");
-    set_best_dist(commBuffer, bestDistance);
-    set_done_flag(commBuffer, doneFlag);
-    MPI_Send(commBuffer, commBufferSize, MPI_INT,
-             dest, TAG_BEST_DIST, MPI_COMM_WORLD);
+// posts the request for the next packet without waiting for it, at most one is in flight
+void request_packet() {
+    LOG_INFO(logt_msg(verbose, rank, "requesting path from manager..."));
+    set_packet_count(requestBuffer, 0);
+    long nodes = atomic_exchange(&solvedSubtreeNodes, 0);
+    long estimate = atomic_exchange(&solvedSubtreeEstimate, 0);
+    int subtrees = atomic_exchange(&solvedSubtrees, 0);
+    long cost = subtrees > 0 ? nodes / subtrees : 0;
+    long estimatePerSubtree = subtrees > 0 ? estimate / subtrees : 0;
+    requestBuffer[OFFSET_SUBTREE_COST] = cost > INT_MAX ? INT_MAX : (int) cost;
+    requestBuffer[OFFSET_SUBTREE_ESTIMATE] = estimatePerSubtree > INT_MAX ? INT_MAX : (int) estimatePerSubtree;
+    MPI_Isend(requestBuffer, PACKET_HEADER_SIZE, MPI_INT,
+              MANAGER, TAG_REQUEST_PATH, MPI_COMM_WORLD, &packetSendRequest);
+    count_message(PACKET_HEADER_SIZE);
+    MPI_Irecv(commBuffer, commBufferSize, MPI_INT,
+              MANAGER, TAG_REQUEST_PATH, MPI_COMM_WORLD, &packetRecvRequest);
+    packetPending = true;
 }
 
-int *get_path_from_manager() {
-    logt_msg(verbose, rank, "requesting path from manager...");
-    MPI_Send(commBuffer, commBufferSize, MPI_INT,
-             MANAGER, TAG_REQUEST_PATH, MPI_COMM_WORLD);
-    MPI_Status status;
-    logt_msg(verbose, rank, "waiting for path from manager...");
-    MPI_Recv(commBuffer, commBufferSize, MPI_INT,
-             MANAGER, TAG_REQUEST_PATH, MPI_COMM_WORLD, &status);
+/*
+ * Completes the pending packet request, blocking only if wait is set; the time spent blocked
+ * counts as idle. Returns false if the packet has not arrived yet.
+ */
+bool receive_packet(bool wait) {
+    if (!packetPending) return false;
+    int arrived = false;
+    MPI_Test(&packetRecvRequest, &arrived, MPI_STATUS_IGNORE);
+    if (!arrived) {
+        if (!wait) return false;
+        LOG_INFO(logt_msg(verbose, rank, "waiting for path from manager..."));
+        double waitStart = MPI_Wtime();
+        MPI_Wait(&packetRecvRequest, MPI_STATUS_IGNORE);
+        search.stats.seconds[STAT_IDLE_TIME] += MPI_Wtime() - waitStart;
+    }
+    MPI_Wait(&packetSendRequest, MPI_STATUS_IGNORE);
+    packetPending = false;
     doneFlag = get_done_flag(commBuffer);
     if (doneFlag) {
-        logt_msg(verbose, rank, "received work is done. exiting...");
-        return NULL;
+        LOG_INFO(logt_msg(verbose, rank, "received work is done. exiting..."));
+        return true;
     }
-    logt_msg(verbose, rank, "received path from manager.");
-    int *path = commBuffer;
-    bestDistance = get_best_dist(path);
-    return path;
+    LOG_INFO(logt_msg(verbose, rank, "received path from manager."));
+    tsp_lower_best_distance(&problem, get_best_dist(commBuffer));
+    return true;
 }
 
-void send_result_to_manager() {
-    logt_msg(verbose, rank, "sending path to manager...");
-    set_best_dist(commBuffer, bestDistance);
-    MPI_Send(commBuffer, commBufferSize, MPI_INT,
-             MANAGER, TAG_NEW_BEST, MPI_COMM_WORLD);
-    MPI_Status status;
-    logt_msg(verbose, rank, "waiting for best distance from manager...");
-    MPI_Recv(commBuffer, commBufferSize, MPI_INT,
-             MANAGER, TAG_BEST_DIST, MPI_COMM_WORLD, &status);
-    bestDistance = get_best_dist(commBuffer);
+void record_subtree_cost(long nodes, int subtrees, long estimate) {
+    atomic_fetch_add(&solvedSubtreeNodes, nodes);
+    atomic_fetch_add(&solvedSubtreeEstimate, estimate);
+    atomic_fetch_add(&solvedSubtrees, subtrees);
 }
 
-int *init_path() {
-    int *initialPath;
-    allocate_int_array(&initialPath, 1, N + 3);
-    initialPath[0] = 0;
-    set_path_length(initialPath, 1);
-    set_path_dist(initialPath, 0);
-    return initialPath;
+// calibrates the estimates against what the workers really expanded, which the improving bound keeps lowering
+void update_subtree_cost(int cost, int estimate) {
+    if (cost <= 0 || estimate <= 0) return;
+    double ratio = (double) cost / estimate;
+    if (costPerEstimate < 0) {
+        costPerEstimate = ratio;
+    } else {
+        costPerEstimate = (1 - COST_SMOOTHING) * costPerEstimate + COST_SMOOTHING * ratio;
+    }
 }
 
+/*
+ * Knuth's estimator: a random dive from path multiplies up the number of children that survive the bound
+ * on every level, and the sum of these products is in expectation the size of the subtree.
+ * Averaged over PROBE_COUNT dives, capped at INT_MAX.
+ */
+int estimate_subtree_cost(int *path) {
+    double total = 0;
+    for (int probe = 0; probe < PROBE_COUNT; probe++) {
+        memcpy(probePath, path, problem.pathSize * sizeof(int));
+        double width = 1, nodes = 1;
+        while (tsp_get_path_length(&problem, probePath) < N) {
+            int from = tsp_get_last_node(&problem, probePath);
+            int children = 0;
+            for (int i = 0; i < N; i++) {
+                int dist = get_edge_dist(&problem.edgeLayout, from, i);
+                if (dist != 0 && tsp_is_open_child(&problem, probePath, i, dist)) probeChildren[children++] = i;
+            }
+            if (children == 0) break;
+            width *= children;
+            nodes += width;
+            int next = probeChildren[rand_r(&probeSeed) % children];
+            // no tsp_add_node, a probe must not leave its paths in the dominance cache
+            tsp_append_node(&problem, probePath, next, get_edge_dist(&problem.edgeLayout, from, next));
+        }
+        total += nodes;
+    }
+    double estimate = total / PROBE_COUNT;
+    return estimate >= INT_MAX ? INT_MAX : (int) estimate;
+}
 
-void add_path(int *path) {
-    memcpy(&paths[pathsInStack * (N + 3)], path, (N + 3) * sizeof(int));
-    pathsInStack++;
+// estimates the paths from index from upwards and sorts the stack so the most expensive one is on top
+void order_frontier(int from) {
+    for (int p = from; p < search.pathsInStack; p++) {
+        int *path = &search.paths[p * problem.pathSize];
+        tsp_set_path_estimate(&problem, path, estimate_subtree_cost(path));
+    }
+    qsort(search.paths, search.pathsInStack, problem.pathSize * sizeof(int), compare_estimates);
 }
 
-void remove_path(int *path) {
-    pathsInStack--;
-    memcpy(path, &paths[pathsInStack * (N + 3)], (N + 3) * sizeof(int));
+int compare_estimates(const void *a, const void *b) {
+    int estimateA = tsp_get_path_estimate(&problem, a);
+    int estimateB = tsp_get_path_estimate(&problem, b);
+    return (estimateA > estimateB) - (estimateA < estimateB);
 }
 
-void split_work(int *path) {
-    logt_msg(verbose, rank, "expanding path: ");
-    printt_path(verbose, rank, path, get_path_length(path), get_path_dist(path));
-    for (int i = 0; i < N; i++) {
-        int w = add_node(path, i);
-        if (w < 0) continue;
-        add_path(path);
-        remove_node(path, w);
-    }
-}
-
-void solve(int *path) {
-    add_path(path);
-    while (pathsInStack > 0) {
-        remove_path(path);
-        printt_path(verbose, rank, path, get_path_length(path), get_path_dist(path));
-        if (get_path_length(path) == N) {
-            update_result(path);
+// nodes a worker is expected to expand for the subtree below path
+double get_predicted_cost(int *path) {
+    return tsp_get_path_estimate(&problem, path) * (costPerEstimate > 0 ? costPerEstimate : 1);
+}
+
+/*
+ * Takes paths from the top, the most expensive first, while the packet stays below TARGET_PACKET_NODES:
+ * expensive subtrees travel alone and cheap ones in batches, without starving the other workers.
+ */
+int get_packet_size() {
+    int pathsInStack = search.pathsInStack;
+    int fairShare = nThreads > 1 ? pathsInStack / (nThreads - 1) : pathsInStack;
+    int size = 0;
+    double cost = 0;
+    while (size < PACKET_MAX_PATHS && size < fairShare) {
+        double next = get_predicted_cost(&search.paths[(pathsInStack - 1 - size) * problem.pathSize]);
+        if (size > 0 && cost + next > TARGET_PACKET_NODES) break;
+        cost += next;
+        size++;
+    }
+    if (size < 1) size = 1;
+    return size;
+}
+
+// breadth-first expansion of the root down to splitDepth before any worker is served
+void pre_split_work() {
+    int pathSize = problem.pathSize;
+    int depth = splitDepth < N - 2 ? splitDepth : N - 2;
+    int *path = search.path;
+    tsp_init_path(&problem, path);
+    tsp_push_path(&search, path);
+    for (int level = 0; level < depth; level++) {
+        int levelCount = search.pathsInStack;
+        int *current;
+        allocate_int_array(&current, levelCount, pathSize);
+        memcpy(current, search.paths, levelCount * pathSize * sizeof(int));
+        search.pathsInStack = 0;
+        tsp_reserve_paths(&search, levelCount * (N - level - 1));
+        for (int p = 0; p < levelCount; p++) {
+            memcpy(path, &current[p * pathSize], pathSize * sizeof(int));
+            for (int i = 0; i < N; i++) {
+                int w = tsp_add_node(&search, path, i);
+                if (w < 0) continue;
+                tsp_push_path(&search, path);
+                tsp_remove_node(&problem, path, w);
+            }
+        }
+        free(current);
+    }
+    // leave room for the frontier ensure_work_available splits up to
+    int frontierLimit = FRONTIER_PER_WORKER * (nThreads - 1);
+    int pathsInStack = search.pathsInStack;
+    tsp_reserve_paths(&search, (pathsInStack > frontierLimit ? pathsInStack : frontierLimit) + N);
+    order_frontier(0);
+}
+
+/*
+ * Splits the most expensive path one level deeper while it is predicted to cost more than a packet should,
+ * so no worker is handed a huge subtree that the others would wait for at the end of the search.
+ * The children join the frontier in order, which stays below FRONTIER_PER_WORKER paths per worker.
+ */
+void ensure_work_available() {
+    int frontierLimit = FRONTIER_PER_WORKER * (nThreads - 1);
+    int *path = search.path;
+    while (search.pathsInStack > 0 && search.pathsInStack < frontierLimit) {
+        int *top = &search.paths[(search.pathsInStack - 1) * problem.pathSize];
+        if (tsp_get_path_length(&problem, top) >= N - 1 || get_predicted_cost(top) <= TARGET_PACKET_NODES) break;
+        tsp_pop_path(&search, path);
+        int before = search.pathsInStack;
+        split_work(path);
+        order_frontier(before);
+    }
+}
+
+/*
+ * Work stealing mode: every rank searches its own stack, rank 0 starts with the root path.
+ * Idle ranks ask random victims for work, which donate the shallowest entries of their stack.
+ * Termination is detected with Dijkstra-Safra token passing; steal replies carrying work are the
+ * counted basic messages, steal requests and empty replies are control messages.
+ */
+void run_work_stealing() {
+    if (rank == 0) {
+        if (options.warmStart) warm_start();
+        tsp_init_path(&problem, search.path);
+        tsp_push_path(&search, search.path);
+    }
+    MPI_Status status;
+    doneFlag = false;
+    while (!doneFlag) {
+        // a stopped rank keeps its stack and stays passive until termination is detected
+        if (tsp_has_work(&search) && !stopRequested) {
+            tsp_expand(&search, STEAL_POLL_INTERVAL);
+            refresh_best_distance();
+            count_limit_nodes();
+            check_limits();
+            int pending = true;
+            while (pending) {
+                MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &pending, &status);
+                if (pending) handle_steal_message(&status);
+            }
             continue;
         }
-        for (int i = 0; i < N; i++) {
-            int w = add_node(path, i);
-            if (w < 0) continue;
-            add_path(path);
-            remove_node(path, w);
+        if (nThreads == 1) break;
+        if (holdingToken) pass_token();
+        if (doneFlag) break;
+        if (!stealOutstanding && !stopRequested) send_steal_request();
+        double waitStart = MPI_Wtime();
+        MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        search.stats.seconds[STAT_IDLE_TIME] += MPI_Wtime() - waitStart;
+        handle_steal_message(&status);
+    }
+    finish_work_stealing();
+    if (stopRequested) lower_open_bound(tsp_get_search_open_bound(&search));
+}
+
+void handle_steal_message(MPI_Status *status) {
+    int source = status->MPI_SOURCE;
+    if (status->MPI_TAG == TAG_STEAL_REQUEST) {
+        MPI_Recv(NULL, 0, MPI_INT, source, TAG_STEAL_REQUEST, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        answer_steal_request(source);
+    } else if (status->MPI_TAG == TAG_STEAL_REPLY) {
+        receive_stolen_paths(source);
+    } else if (status->MPI_TAG == TAG_TOKEN) {
+        MPI_Recv(token, 2, MPI_INT, source, TAG_TOKEN, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        holdingToken = true;
+        tokenReturned = rank == 0;
+    } else if (status->MPI_TAG == TAG_DONE) {
+        MPI_Recv(NULL, 0, MPI_INT, source, TAG_DONE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        LOG_INFO(logt_msg(verbose, rank, "received work is done."));
+        doneFlag = true;
+    } else {
+        LOG_INFO(logt_msg(verbose, rank, "unknown tag received!"));
+    }
+}
+
+void send_steal_request() {
+    int victim = (int) (rand_r(&stealSeed) % (nThreads - 1));
+    if (victim >= rank) victim++;
+    LOG_INFO(logt_msg(verbose, rank, "requesting work from another rank..."));
+    MPI_Send(NULL, 0, MPI_INT, victim, TAG_STEAL_REQUEST, MPI_COMM_WORLD);
+    count_message(0);
+    stealOutstanding = true;
+}
+
+void answer_steal_request(int thief) {
+    int count = stopRequested ? 0 : tsp_donate_paths(&search, &stealBuffer[STEAL_HEADER_SIZE], STEAL_MAX_PATHS);
+    if (count > 0) safraCounter++;
+    stealBuffer[OFFSET_STEAL_COUNT] = count;
+    stealBuffer[OFFSET_STEAL_BEST_DIST] = problem.bestDistance;
+    MPI_Send(stealBuffer, STEAL_HEADER_SIZE + count * problem.pathSize, MPI_INT,
+             thief, TAG_STEAL_REPLY, MPI_COMM_WORLD);
+    count_message(STEAL_HEADER_SIZE + count * problem.pathSize);
+}
+
+void receive_stolen_paths(int source) {
+    MPI_Recv(stealBuffer, stealBufferSize, MPI_INT,
+             source, TAG_STEAL_REPLY, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    stealOutstanding = false;
+    int count = stealBuffer[OFFSET_STEAL_COUNT];
+    tsp_lower_best_distance(&problem, stealBuffer[OFFSET_STEAL_BEST_DIST]);
+    if (count == 0) return;
+    LOG_INFO(logt_msg(verbose, rank, "received stolen paths."));
+    safraCounter--;
+    safraBlack = true;
+    for (int p = 0; p < count; p++) {
+        tsp_push_path(&search, &stealBuffer[STEAL_HEADER_SIZE + p * problem.pathSize]);
+    }
+}
+
+// called while this rank is passive and holds the token
+void pass_token() {
+    int next = (rank + 1) % nThreads;
+    if (rank == 0) {
+        if (tokenReturned && !token[TOKEN_BLACK] && !safraBlack && token[TOKEN_COUNT] + safraCounter == 0) {
+            LOG_INFO(logt_msg(verbose, rank, "termination detected."));
+            for (int dest = 1; dest < nThreads; dest++) {
+                MPI_Send(NULL, 0, MPI_INT, dest, TAG_DONE, MPI_COMM_WORLD);
+                count_message(0);
+            }
+            doneFlag = true;
+            holdingToken = false;
+            return;
+        }
+        token[TOKEN_COUNT] = 0;
+        token[TOKEN_BLACK] = false;
+    } else {
+        token[TOKEN_COUNT] += safraCounter;
+        if (safraBlack) token[TOKEN_BLACK] = true;
+    }
+    safraBlack = false;
+    holdingToken = false;
+    tokenReturned = false;
+    MPI_Send(token, 2, MPI_INT, next, TAG_TOKEN, MPI_COMM_WORLD);
+    count_message(2);
+}
+
+/*
+ * After termination only control messages can still be in flight: each rank has at most one
+ * outstanding steal request. A rank joins the barrier once its own request is answered and keeps
+ * rejecting requests until everybody has joined, so no message is left unmatched.
+ */
+void finish_work_stealing() {
+    if (nThreads == 1) return;
+    MPI_Request barrier;
+    bool inBarrier = false;
+    while (true) {
+        if (!stealOutstanding && !inBarrier) {
+            MPI_Ibarrier(MPI_COMM_WORLD, &barrier);
+            inBarrier = true;
+        }
+        int flag = false;
+        if (inBarrier) {
+            MPI_Test(&barrier, &flag, MPI_STATUS_IGNORE);
+            if (flag) break;
         }
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &flag, &status);
+        if (flag) handle_steal_message(&status);
     }
 }
 
-int add_node(int *path, int i) {
-    int currPathNode = get_last_node(path);
-    if (i == currPathNode) return -1;
-    if (is_already_in_path(path, i)) return -1;
-    int dist = edgeMatrix[currPathNode * N + i];
-    if (dist == 0) return -1;
-    int newDist = get_path_dist(path) + dist;
-    if (prune && newDist > bestDistance) {
-        logt_prune(verbose, rank, newDist, bestDistance);
-        return -1;
+void init_best_distance_window() {
+    MPI_Aint windowSize = rank == MANAGER ? sizeof(SharedState) : 0;
+    MPI_Win_allocate(windowSize, 1, MPI_INFO_NULL, MPI_COMM_WORLD, &sharedState, &bestDistanceWin);
+    if (rank == MANAGER) {
+        sharedState->bestDistance = INT_MAX;
+        sharedState->stopFlag = false;
+        sharedState->expandedNodes = 0;
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, bestDistanceWin);
+}
+
+void free_best_distance_window() {
+    MPI_Win_unlock_all(bestDistanceWin);
+    MPI_Win_free(&bestDistanceWin);
+}
+
+// atomically lowers the global best distance without involving the manager's CPU
+void publish_best_distance(int distance) {
+    if (distance >= publishedBestDistance) return;
+    publishedBestDistance = distance;
+    int previous;
+    MPI_Fetch_and_op(&distance, &previous, MPI_INT, MANAGER, offsetof(SharedState, bestDistance), MPI_MIN, bestDistanceWin);
+    MPI_Win_flush(MANAGER, bestDistanceWin);
+    count_message(1);
+}
+
+void refresh_best_distance() {
+    int global;
+    MPI_Fetch_and_op(NULL, &global, MPI_INT, MANAGER, offsetof(SharedState, bestDistance), MPI_NO_OP, bestDistanceWin);
+    MPI_Win_flush(MANAGER, bestDistanceWin);
+    count_message(1);
+    tsp_lower_best_distance(&problem, global);
+}
+
+// every search thread hands in its expansions since the last call, the master thread shares them
+void count_limit_nodes() {
+    long expanded = search.stats.counts[STAT_EXPANDED] - countedNodes;
+    countedNodes += expanded;
+    atomic_fetch_add(&unreportedNodes, expanded);
+}
+
+// master thread only: adds this rank's expansions to the shared count and raises or reads the stop flag
+bool check_limits() {
+    if (stopRequested) return true;
+    if (options.timeLimit == 0 && options.nodeLimit == 0) return false;
+    int stop = options.timeLimit > 0 && MPI_Wtime() - startTime >= options.timeLimit;
+    if (options.nodeLimit > 0) {
+        long expanded = atomic_exchange(&unreportedNodes, 0);
+        long before;
+        MPI_Fetch_and_op(&expanded, &before, MPI_LONG, MANAGER, offsetof(SharedState, expandedNodes), MPI_SUM,
+                         bestDistanceWin);
+        MPI_Win_flush(MANAGER, bestDistanceWin);
+        count_message(2);
+        if (before + expanded >= options.nodeLimit) stop = true;
+    }
+    int raised;
+    MPI_Fetch_and_op(&stop, &raised, MPI_INT, MANAGER, offsetof(SharedState, stopFlag),
+                     stop ? MPI_REPLACE : MPI_NO_OP, bestDistanceWin);
+    MPI_Win_flush(MANAGER, bestDistanceWin);
+    count_message(1);
+    if (stop || raised) {
+        LOG_INFO(logt_msg(verbose, rank, "search limit reached, stopping."));
+        stopRequested = true;
+    }
+    return stopRequested;
+}
+
+/*
+ * Hybrid mode: one rank per node runs threadsPerRank search threads sharing the edge matrix.
+ * MPI is funneled through the master thread, which keeps the rank-local queue filled with
+ * subtrees from the manager and publishes improvements found by any thread of the rank.
+ */
+void run_hybrid_worker() {
+    allocate_int_array(&localQueue, threadsPerRank + PACKET_MAX_PATHS, problem.pathSize);
+    localQueueCount = 0;
+    omp_init_lock(&localQueueLock);
+    SearchStats total;
+    reset_stats(&total);
+#pragma omp parallel num_threads(threadsPerRank)
+    {
+        bool master = omp_get_thread_num() == 0;
+        if (!master) tsp_init_search(&search, &problem, ROOT_PATHS, threadsPerRank);
+        int *path;
+        allocate_int_array(&path, 1, problem.pathSize);
+        while (true) {
+            if (master) refill_local_queue(false);
+            if (pop_local_queue(path)) {
+                if (stopRequested) {
+                    lower_open_bound(tsp_get_path_bound(&problem, path));
+                    continue;
+                }
+                long expandedBefore = search.stats.counts[STAT_EXPANDED];
+                long estimate = tsp_get_path_estimate(&problem, path);
+                tsp_push_path(&search, path);
+                solve();
+                record_subtree_cost(search.stats.counts[STAT_EXPANDED] - expandedBefore, 1, estimate);
+            } else if (doneFlag || (stopRequested && !master)) {
+                // the master keeps going until the manager confirms, packets still in flight are bounded
+                break;
+            } else if (master) {
+                refill_local_queue(true);
+            } else {
+                sched_yield();
+            }
+        }
+        if (stopRequested) lower_open_bound(tsp_get_search_open_bound(&search));
+#pragma omp critical(stats)
+        add_stats(&total, &search.stats);
+        free(path);
+        if (!master) tsp_free_search(&search);
     }
-    int pathLength = get_path_length(path);
-    path[pathLength] = i;
-    set_path_length(path, pathLength + 1);
-    set_path_dist(path, newDist);
-    return dist;
+    search.stats = total;
+    publish_best_distance(problem.bestDistance);
+    omp_destroy_lock(&localQueueLock);
+    free(localQueue);
 }
 
-void remove_node(int *path, int w) {
-    set_path_dist(path, get_path_dist(path) - w);
-    set_path_length(path, get_path_length(path) - 1);
+/*
+ * Master thread only: keeps a packet request in flight while fewer subtrees than search threads
+ * are queued. Blocks for the packet only if wait is set, i.e. when the master has nothing else to do.
+ */
+void refill_local_queue(bool wait) {
+    while (!doneFlag) {
+        if (!packetPending) {
+            omp_set_lock(&localQueueLock);
+            int queued = localQueueCount;
+            omp_unset_lock(&localQueueLock);
+            if (queued >= threadsPerRank) return;
+            request_packet();
+        }
+        if (!receive_packet(wait)) return;
+        int count = doneFlag ? 0 : get_packet_count(commBuffer);
+        for (int p = 0; p < count; p++) push_local_queue(get_packet_path(commBuffer, p));
+    }
 }
 
-void update_result(int *path) {
-    int currPathNode = get_last_node(path);
-    int distTo0 = edgeMatrix[currPathNode * N + 0];
-    if (distTo0 == 0) {
-        logt_msg(verbose, rank, "missing way back to 0!");
+void push_local_queue(int *path) {
+    omp_set_lock(&localQueueLock);
+    memcpy(&localQueue[localQueueCount * problem.pathSize], path, problem.pathSize * sizeof(int));
+    localQueueCount++;
+    omp_unset_lock(&localQueueLock);
+}
+
+bool pop_local_queue(int *path) {
+    bool found = false;
+    omp_set_lock(&localQueueLock);
+    if (localQueueCount > 0) {
+        localQueueCount--;
+        memcpy(path, &localQueue[localQueueCount * problem.pathSize], problem.pathSize * sizeof(int));
+        found = true;
+    }
+    omp_unset_lock(&localQueueLock);
+    return found;
+}
+
+// MPI is funneled through the master thread, the other search threads only read the shared bound
+void poll_manager() {
+    count_limit_nodes();
+    if (omp_get_thread_num() != 0) return;
+    if (threadsPerRank > 1) {
+        publish_best_distance(problem.bestDistance);
+        refill_local_queue(false);
+    }
+    refresh_best_distance();
+    check_limits();
+}
+
+// the ranks holding a shortest path ship it to the manager once the search has finished, and of equally short
+// ones the manager keeps the one the sequential solver reports, so ties do not depend on the rank count
+// bestDistance may already hold a bound found elsewhere, so ranks compete with their own bestPath
+void collect_best_path() {
+    int dist = tsp_get_path_dist(&problem, problem.bestPath);
+    int *dists = malloc(nThreads * sizeof(int));
+    MPI_Allgather(&dist, 1, MPI_INT, dists, 1, MPI_INT, MPI_COMM_WORLD);
+    int best = INT_MAX;
+    for (int i = 0; i < nThreads; i++) best = dists[i] < best ? dists[i] : best;
+    if (rank == MANAGER) problem.bestDistance = best;
+    if (best != INT_MAX && rank != MANAGER && dist == best) {
+        MPI_Send(problem.bestPath, problem.pathSize, MPI_INT, MANAGER, TAG_NEW_BEST, MPI_COMM_WORLD);
+        count_message(problem.pathSize);
+    } else if (best != INT_MAX && rank == MANAGER) {
+        int *tour = malloc(problem.pathSize * sizeof(int));
+        bool hasBest = dist == best;
+        for (int i = 0; i < nThreads; i++) {
+            if (i == MANAGER || dists[i] != best) continue;
+            MPI_Recv(tour, problem.pathSize, MPI_INT, i, TAG_NEW_BEST, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            if (!hasBest || tsp_is_preferred_tour(&problem, tour, problem.bestPath)) {
+                memcpy(problem.bestPath, tour, problem.pathSize * sizeof(int));
+                hasBest = true;
+            }
+        }
+        free(tour);
+    }
+    free(dists);
+}
+
+void warm_start() {
+    int distance = tsp_warm_start(&problem);
+    if (distance == INT_MAX) {
+        LOG_INFO(logt_msg(verbose, rank, "no feasible warm start tour found."));
         return;
     }
-    path[N] = 0;
-    int totalDist = get_path_dist(path) + distTo0;
-    set_path_dist(path, totalDist);
-    set_path_length(path, N + 1);
-    printt_path(verbose, rank, path, get_path_length(path), get_path_dist(path));
-    logt_curr_best_dist(verbose, rank, totalDist, bestDistance);
-    if (totalDist < bestDistance) {
-        logt_msg(verbose, rank, "new best!");
-        bestDistance = totalDist;
-        memcpy(bestPath, path, (N + 3) * sizeof(int));
-        send_result_to_manager();
+    publish_improvement(distance);
+    LOG_INFO(logt_msg(verbose, rank, "warm start tour:"));
+    LOG_INFO(printt_path(verbose, rank, problem.bestPath, N + 1, distance));
+}
+
+void split_work(int *path) {
+    LOG_TRACE(logt_msg(verbose, rank, "expanding path: "));
+    LOG_TRACE(printt_path(verbose, rank, path, tsp_get_path_length(&problem, path), tsp_get_path_dist(&problem, path)));
+    tsp_push_children(&search, path);
+}
+
+// solves everything on the stack of the calling thread unless the search is stopped
+void solve() {
+    while (tsp_has_work(&search) && !stopRequested) {
+        tsp_expand(&search, BOUND_POLL_INTERVAL);
+        poll_manager();
     }
 }
 
+// streams every improvement this rank finds, so a stopped or killed run still shows what it had found
+void report_best(int distance) {
+    printf("T%d: new best %d after %.3fs\n", rank, distance, MPI_Wtime() - startTime);
+    fflush(stdout);
+}
+
+// reportBest of the problem: MPI is funneled through the master thread, the others leave publishing to poll_manager
+void publish_improvement(int distance) {
+    report_best(distance);
+    if (omp_get_thread_num() == 0) publish_best_distance(distance);
+}
 
 bool parse_args(int argc, char *argv[]) {
     bool applyExample = argc >= 2 && strcmp(argv[1], "example") == 0;
+    bool applyFile = argc >= 3 && strcmp(argv[1], "file") == 0;
+    bool applyBatch = argc >= 3 && strcmp(argv[1], "batch") == 0;
+    tsp_default_options(&options);
     if (applyExample) {
-        edgeMatrix = (int *) EXAMPLE_EDGES;
-        N = EXAMPLE_N_NODES;
+        graphSource = GRAPH_EXAMPLE;
     } else if (argc < 3) {
         printf("Not enough arguments!\n");
-        printf("Usage: <program> <nNodes> <%%population> [-noprune] [-verbose]\n");
-        printf("Alternative: <program> \"example\" [-noprune] [-verbose]\n");
+        printf("Usage: <program> <nNodes> <%%population> [-noprune] [-bound=none|partial|minout|ap] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-engine=dfs|inplace|ils] [-cache-mb=M] [-restarts=R] [-time-limit=S] [-node-limit=N] [-steal] [-threads=K] [-split-depth=D] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index] [-verbose]\n");
+        printf("Alternative: <program> \"example\" [-noprune] [-bound=none|partial|minout|ap] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-engine=dfs|inplace|ils] [-cache-mb=M] [-restarts=R] [-time-limit=S] [-node-limit=N] [-steal] [-threads=K] [-split-depth=D] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index] [-verbose]\n");
+        printf("Alternative: <program> \"file\" <TSPLIB or binary matrix file> [-noprune] [-bound=none|partial|minout|ap] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-engine=dfs|inplace|ils] [-cache-mb=M] [-restarts=R] [-time-limit=S] [-node-limit=N] [-steal] [-threads=K] [-split-depth=D] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index] [-verbose]\n");
+        printf("Alternative: <program> \"batch\" <concatenated binary matrices> [-noprune] [-bound=none|partial|minout|ap] [-engine=dfs|inplace] [-cache-mb=M] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-time-limit=S] [-node-limit=N] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index]\n");
         return false;
+    } else if (applyFile) {
+        graphSource = GRAPH_FILE;
+        graphFile = argv[2];
+    } else if (applyBatch) {
+        graphSource = GRAPH_BATCH;
+        graphFile = argv[2];
     } else {
         char *endptr;
-        int nodesArg = (int) strtol(argv[1], &endptr, 10);
-        int populationArg = (int) strtol(argv[2], &endptr, 10);
-        N = nodesArg;
-        edgeMatrix = get_random_edge_matrix(nodesArg, populationArg);
+        graphSource = GRAPH_RANDOM;
+        randomNodes = (int) strtol(argv[1], &endptr, 10);
+        randomPopulation = (int) strtol(argv[2], &endptr, 10);
     }
     for (int a = 0; a < argc; a++) {
         if (strcmp(argv[a], "-noprune") == 0) {
-            prune = false;
+            options.boundMode = TSP_BOUND_NONE;
+        } else if (strcmp(argv[a], "-nowarmstart") == 0) {
+            options.warmStart = false;
+        } else if (strcmp(argv[a], "-nosymmetry") == 0) {
+            options.symmetryBreaking = false;
+        } else if (strcmp(argv[a], "-nosimd") == 0) {
+            options.simd = false;
+        } else if (strcmp(argv[a], "-noreduce") == 0) {
+            options.reduceGraph = false;
+        } else if (strcmp(argv[a], "-reach") == 0) {
+            options.reachChecks = true;
+        } else if (strncmp(argv[a], "-engine=", 8) == 0) {
+            if (!parse_engine(argv[a] + 8)) return false;
+        } else if (strncmp(argv[a], "-restarts=", 10) == 0) {
+            restarts = (int) strtol(argv[a] + 10, NULL, 10);
+        } else if (strncmp(argv[a], "-cache-mb=", 10) == 0) {
+            options.cacheMegabytes = (int) strtol(argv[a] + 10, NULL, 10);
+        } else if (strcmp(argv[a], "-steal") == 0) {
+            workStealing = true;
+        } else if (strncmp(argv[a], "-threads=", 9) == 0) {
+            threadsPerRank = (int) strtol(argv[a] + 9, NULL, 10);
+        } else if (strncmp(argv[a], "-time-limit=", 12) == 0) {
+            options.timeLimit = strtod(argv[a] + 12, NULL);
+        } else if (strncmp(argv[a], "-node-limit=", 12) == 0) {
+            options.nodeLimit = strtol(argv[a] + 12, NULL, 10);
+        } else if (strncmp(argv[a], "-split-depth=", 13) == 0) {
+            splitDepth = (int) strtol(argv[a] + 13, NULL, 10);
+        } else if (strncmp(argv[a], "-bound=", 7) == 0) {
+            if (!parse_bound_mode(argv[a] + 7)) return false;
+        } else if (strncmp(argv[a], "-layout=", 8) == 0) {
+            if (!parse_edge_layout(argv[a] + 8, &options.layout)) return false;
+        } else if (strncmp(argv[a], "-order=", 7) == 0) {
+            if (!parse_child_order(argv[a] + 7)) return false;
         } else if (strcmp(argv[a], "-verbose") == 0) {
             verbose = true;
         }
     }
+    options.inPlace = engine == ENGINE_INPLACE;
+    if (threadsPerRank < 1 || splitDepth < 0 || options.cacheMegabytes < 0) {
+        printf("Invalid thread count, split depth or cache size!\n");
+        return false;
+    }
+    if (options.timeLimit < 0 || options.nodeLimit < 0) {
+        printf("Invalid search limit!\n");
+        return false;
+    }
+    if (graphSource == GRAPH_BATCH && engine == ENGINE_ILS) {
+        printf("Batch mode needs the dfs or inplace engine!\n");
+        return false;
+    }
+    if (options.boundMode == TSP_BOUND_AP && engine != ENGINE_DFS) {
+        printf("The ap bound needs the dfs engine!\n");
+        return false;
+    }
+    if (options.reachChecks && engine != ENGINE_DFS) {
+        printf("-reach needs the dfs engine!\n");
+        return false;
+    }
+    if (engine == ENGINE_ILS && (options.nodeLimit > 0 || restarts < 0 || (restarts == 0 && options.timeLimit == 0))) {
+        printf("The ils engine needs a restart count or a time limit, and no node limit!\n");
+        return false;
+    }
+    if (engine == ENGINE_ILS && threadsPerRank > 1) {
+        printf("The ils engine runs one search per rank, start more ranks instead of -threads!\n");
+        return false;
+    }
+    if (threadsPerRank > 1 && workStealing) {
+        printf("-threads cannot be combined with -steal!\n");
+        return false;
+    }
     return true;
 }
 
-int get_path_length(int *p) {
-    return p[N + OFFSET_PATH_LEN];
+/*
+ * Batch mode: every rank solves whole instances with the reentrant solver of TspSolver.h, one at a time on a
+ * single thread, which gets the whole -cache-mb.
+ * The manager loads the batch and broadcasts it, then all ranks claim the next unsolved instance from a
+ * counter in an RMA window, so faster ranks simply take more instances. Each result is filled in by the
+ * rank that solved it and summed onto the manager, the other ranks contribute zeros.
+ */
+int solve_batch() {
+    int count = 0;
+    int *nodeCounts = NULL;
+    int *matrices = NULL;
+    if (rank == MANAGER) matrices = load_binary_batch(graphFile, &count, &nodeCounts);
+    MPI_Bcast(&count, 1, MPI_INT, MANAGER, MPI_COMM_WORLD);
+    if (count == 0) return ERR_INVALID_ARGS;
+    if (rank != MANAGER) nodeCounts = malloc(count * sizeof(int));
+    MPI_Bcast(nodeCounts, count, MPI_INT, MANAGER, MPI_COMM_WORLD);
+    size_t *matrixOffsets = malloc(count * sizeof(size_t));
+    size_t *tourOffsets = malloc(count * sizeof(size_t));
+    size_t matrixEntries = 0, tourEntries = 0;
+    for (int i = 0; i < count; i++) {
+        matrixOffsets[i] = matrixEntries;
+        tourOffsets[i] = tourEntries;
+        matrixEntries += (size_t) nodeCounts[i] * nodeCounts[i];
+        tourEntries += nodeCounts[i] + 1;
+    }
+    if (rank != MANAGER) matrices = malloc(matrixEntries * sizeof(int));
+    MPI_Bcast(matrices, (int) matrixEntries, MPI_INT, MANAGER, MPI_COMM_WORLD);
+    // distance, lower bound and stopped flag per instance, then the tours
+    int *results = calloc(3 * count + tourEntries, sizeof(int));
+    int *tours = &results[3 * count];
+    int *nextInstance;
+    MPI_Win counterWin;
+    MPI_Win_allocate(rank == MANAGER ? sizeof(int) : 0, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD,
+                     &nextInstance, &counterWin);
+    if (rank == MANAGER) *nextInstance = 0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, counterWin);
+    double t = MPI_Wtime();
+    TspContext *context = tsp_create_context();
+    reset_stats(&search.stats);
+    int one = 1;
+    while (true) {
+        int i;
+        MPI_Fetch_and_op(&one, &i, MPI_INT, MANAGER, 0, MPI_SUM, counterWin);
+        MPI_Win_flush(MANAGER, counterWin);
+        count_message(1);
+        if (i >= count) break;
+        TspResult result;
+        tsp_solve(context, &matrices[matrixOffsets[i]], nodeCounts[i], &options, &result);
+        add_stats(&search.stats, &result.stats);
+        results[3 * i] = result.distance;
+        results[3 * i + 1] = result.lowerBound;
+        results[3 * i + 2] = result.stopped;
+        memcpy(&tours[tourOffsets[i]], result.tour, (nodeCounts[i] + 1) * sizeof(int));
+    }
+    tsp_free_context(context);
+    MPI_Win_unlock_all(counterWin);
+    MPI_Win_free(&counterWin);
+    int entries = (int) (3 * count + tourEntries);
+    MPI_Reduce(rank == MANAGER ? MPI_IN_PLACE : results, results, entries, MPI_INT, MPI_SUM, MANAGER, MPI_COMM_WORLD);
+    SearchStats total;
+    MPI_Reduce(search.stats.counts, total.counts, STAT_COUNTERS, MPI_LONG, MPI_SUM, MANAGER, MPI_COMM_WORLD);
+    MPI_Reduce(search.stats.seconds, total.seconds, STAT_TIMERS, MPI_DOUBLE, MPI_SUM, MANAGER, MPI_COMM_WORLD);
+    t = MPI_Wtime() - t;
+    if (rank == MANAGER) {
+        for (int i = 0; i < count; i++) {
+            int distance = results[3 * i];
+            bool stopped = results[3 * i + 2];
+            if (distance == INT_MAX) {
+                printf("Instance %d: %s\n", i, stopped ? "no tour found before the search limit" : "no solution possible");
+                continue;
+            }
+            printf("Instance %d: ", i);
+            print_path(true, &tours[tourOffsets[i]], nodeCounts[i] + 1, distance);
+            if (stopped) printf("Instance %d: stopped at the search limit, lower bound %d\n", i, results[3 * i + 1]);
+        }
+        printf("\nSolved %d instances on %d ranks in %.3fs, %.1f instances per second\n", count, nThreads, t, count / t);
+        printf("Expanded %ld nodes, pruned %ld\n", total.counts[STAT_EXPANDED], get_pruned(&total));
+        print_stats(&total, nThreads);
+    }
+    free(results);
+    free(tourOffsets);
+    free(matrixOffsets);
+    free(nodeCounts);
+    free(matrices);
+    return 0;
 }
 
-void set_path_length(int *p, int len) {
-    p[N + OFFSET_PATH_LEN] = len;
+/*
+ * Large instances: every rank runs one local search restart per round (see LocalSearch.h), the restarts
+ * dealt round-robin. After each round a MINLOC reduction finds the best tour of all ranks and its rank
+ * broadcasts it, so the odd rounds of every rank kick that tour with their own seeds. With a time limit
+ * the rounds go on until any rank sees it run out.
+ */
+int solve_local_search() {
+    LocalSearch *localSearch = local_search_create(edgeMatrix, N);
+    int *tour = malloc((N + 1) * sizeof(int));
+    int *bestTour = malloc((N + 1) * sizeof(int));
+    reset_stats(&search.stats);
+    int bestDistance = INT_MAX;
+    startTime = MPI_Wtime();
+    for (int round = 0; restarts == 0 || round * nThreads < restarts; round++) {
+        int restart = round * nThreads + rank;
+        struct {
+            int distance;
+            int rank;
+        } local = {INT_MAX, rank}, global;
+        if (restarts == 0 || restart < restarts) {
+            unsigned int seed = (unsigned int) restart + 1;
+            bool fresh = round % 2 == 0 || bestDistance == INT_MAX;
+            if (!fresh) memcpy(tour, bestTour, (N + 1) * sizeof(int));
+            local.distance = local_search_run(localSearch, tour, fresh, &seed);
+            search.stats.counts[STAT_TOURS]++;
+        }
+        MPI_Allreduce(&local, &global, 1, MPI_2INT, MPI_MINLOC, MPI_COMM_WORLD);
+        if (global.distance < bestDistance) {
+            if (rank == global.rank) {
+                memcpy(bestTour, tour, (N + 1) * sizeof(int));
+                search.stats.counts[STAT_BOUND_IMPROVEMENTS]++;
+                report_best(global.distance);
+                count_message(N + 1);
+            }
+            MPI_Bcast(bestTour, N + 1, MPI_INT, global.rank, MPI_COMM_WORLD);
+            bestDistance = global.distance;
+        }
+        int timeUp = options.timeLimit > 0 && MPI_Wtime() - startTime >= options.timeLimit, anyTimeUp;
+        MPI_Allreduce(&timeUp, &anyTimeUp, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (anyTimeUp) break;
+    }
+    double t = MPI_Wtime() - startTime;
+    SearchStats total;
+    double maxIdle;
+    reduce_stats(t, &total, &maxIdle);
+    int status = 0;
+    if (rank == MANAGER) {
+        if (bestDistance == INT_MAX) {
+            printf("No tour found by local search!\n");
+            status = -1;
+        } else {
+            printf("\nBest path:\n");
+            printt_path(true, rank, bestTour, N + 1, bestDistance);
+            printf("\nAlgorithm took %.3fs\n", t);
+            printf("Local search over %ld restarts on %d ranks, not proven optimal\n", total.counts[STAT_TOURS], nThreads);
+            print_stats(&total, nThreads);
+        }
+    }
+    free(bestTour);
+    free(tour);
+    local_search_free(localSearch);
+    return status;
 }
 
-int get_path_dist(int *p) {
-    return p[N + OFFSET_PATH_DIST];
+/*
+ * Only the manager reads the graph. It is broadcast once to the first rank of every node, into a shared-memory
+ * window that the other ranks of that node map, so neither startup time nor memory grows with the number of ranks.
+ * A random graph is not broadcast at all, the ranks of every node generate their rows of it in place.
+ * Returns false on all ranks if the manager could not load it.
+ */
+bool share_edge_matrix() {
+    int *loaded = NULL;
+    bool mapped = false;
+    bool generated = graphSource == GRAPH_RANDOM;
+    if (rank == MANAGER) {
+        if (graphSource == GRAPH_EXAMPLE) {
+            loaded = (int *) EXAMPLE_EDGES;
+            N = EXAMPLE_N_NODES;
+        } else if (generated) {
+            N = randomNodes;
+        } else {
+            mapped = is_binary_matrix_file(graphFile);
+            loaded = mapped ? load_binary_matrix(graphFile, &N) : load_tsplib(graphFile, &N);
+            if (loaded == NULL) N = 0;
+        }
+    }
+    MPI_Bcast(&N, 1, MPI_INT, MANAGER, MPI_COMM_WORLD);
+    if (N < 1) return false;
+
+    MPI_Comm nodeComm, leaderComm;
+    int nodeRank;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+    MPI_Comm_rank(nodeComm, &nodeRank);
+    // ordering by world rank makes the manager rank 0 of both its node and the leaders
+    MPI_Comm_split(MPI_COMM_WORLD, nodeRank == 0 ? 0 : MPI_UNDEFINED, rank, &leaderComm);
+    MPI_Aint matrixBytes = nodeRank == 0 ? (MPI_Aint) N * N * (MPI_Aint) sizeof(int) : 0;
+    MPI_Win_allocate_shared(matrixBytes, sizeof(int), MPI_INFO_NULL, nodeComm, &edgeMatrix, &edgeMatrixWin);
+    if (nodeRank != 0) {
+        int dispUnit;
+        MPI_Win_shared_query(edgeMatrixWin, 0, &matrixBytes, &dispUnit, &edgeMatrix);
+    }
+    MPI_Win_fence(0, edgeMatrixWin);
+    if (generated) {
+        // the ranks of a node split the rows of its shared copy, every entry is drawn independently of the others
+        int nodeSize;
+        MPI_Comm_size(nodeComm, &nodeSize);
+        int firstRow = (int) ((long) N * nodeRank / nodeSize);
+        int rowCount = (int) ((long) N * (nodeRank + 1) / nodeSize) - firstRow;
+        fill_random_rows(&edgeMatrix[(size_t) firstRow * N], N, randomPopulation, RANDOM_SEED, firstRow, rowCount,
+                         threadsPerRank);
+        MPI_Win_fence(0, edgeMatrixWin);
+    } else if (rank == MANAGER) {
+        memcpy(edgeMatrix, loaded, matrixBytes);
+        if (mapped) unload_binary_matrix(loaded, N);
+        else if (graphSource != GRAPH_EXAMPLE) free(loaded);
+    }
+    // reduced in the shared copy before the other nodes receive it, a generated copy by every node for itself
+    GraphReduction reduction;
+    if (options.reduceGraph && (rank == MANAGER || (generated && nodeRank == 0))) {
+        hasTour = reduce_graph(edgeMatrix, N, &reduction);
+    }
+    if (leaderComm != MPI_COMM_NULL) {
+        if (!generated) MPI_Bcast(edgeMatrix, N * N, MPI_INT, MANAGER, leaderComm);
+        MPI_Comm_free(&leaderComm);
+    }
+    MPI_Win_fence(0, edgeMatrixWin);
+    MPI_Comm_free(&nodeComm);
+    MPI_Bcast(&hasTour, 1, MPI_C_BOOL, MANAGER, MPI_COMM_WORLD);
+    if (rank == MANAGER && options.reduceGraph && hasTour) {
+        char message[96];
+        snprintf(message, sizeof(message), "preprocessing dropped %d edges, %d edges are forced.",
+                 reduction.droppedEdges, reduction.forcedEdges);
+        LOG_INFO(logt_msg(verbose, rank, message));
+    }
+    return true;
 }
 
-void set_path_dist(int *p, int dist) {
-    p[N + OFFSET_PATH_DIST] = dist;
+bool parse_bound_mode(char *arg) {
+    if (strcmp(arg, "none") == 0) {
+        options.boundMode = TSP_BOUND_NONE;
+    } else if (strcmp(arg, "partial") == 0) {
+        options.boundMode = TSP_BOUND_PARTIAL;
+    } else if (strcmp(arg, "minout") == 0) {
+        options.boundMode = TSP_BOUND_MINOUT;
+    } else if (strcmp(arg, "ap") == 0) {
+        options.boundMode = TSP_BOUND_AP;
+    } else {
+        printf("Unknown bound mode '%s'!\n", arg);
+        return false;
+    }
+    return true;
 }
 
-int get_last_node(int *path) {
-    return path[get_path_length(path) - 1];
+bool parse_engine(char *arg) {
+    if (strcmp(arg, "dfs") == 0) {
+        engine = ENGINE_DFS;
+    } else if (strcmp(arg, "inplace") == 0) {
+        engine = ENGINE_INPLACE;
+    } else if (strcmp(arg, "ils") == 0) {
+        engine = ENGINE_ILS;
+    } else {
+        printf("Unknown engine '%s'!\n", arg);
+        return false;
+    }
+    return true;
 }
 
-bool is_already_in_path(int *path, int node) {
-    for (int i = 0; i < get_path_length(path); i++)
-        if (path[i] == node) return true;
-    return false;
+bool parse_child_order(char *arg) {
+    if (strcmp(arg, "cheapest") == 0) {
+        options.cheapestFirst = true;
+    } else if (strcmp(arg, "index") == 0) {
+        options.cheapestFirst = false;
+    } else {
+        printf("Unknown child order '%s'!\n", arg);
+        return false;
+    }
+    return true;
 }
 
+// folds the bound of what a stopped search left open into openBound
+void lower_open_bound(int bound) {
+#pragma omp critical(open_bound)
+    if (bound < openBound) openBound = bound;
+}
 
 int get_best_dist(int *buf) {
-    return buf[N + OFFSET_BEST_DIST];
+    return buf[OFFSET_BEST_DIST];
 }
 
 void set_best_dist(int *buf, int distance) {
-    buf[N + OFFSET_BEST_DIST] = distance;
+    buf[OFFSET_BEST_DIST] = distance;
 }
 
 bool get_done_flag(int *buf) {
-    return buf[N + OFFSET_DONE_FLAG];
+    return buf[OFFSET_DONE_FLAG];
 }
 
 void set_done_flag(int *buf, int flag) {
-    buf[N + OFFSET_DONE_FLAG] = flag;
+    buf[OFFSET_DONE_FLAG] = flag;
+}
+
+int get_packet_count(int *buf) {
+    return buf[OFFSET_PACKET_COUNT];
+}
+
+void set_packet_count(int *buf, int count) {
+    buf[OFFSET_PACKET_COUNT] = count;
+}
+
+int *get_packet_path(int *buf, int index) {
+    return &buf[PACKET_HEADER_SIZE + index * problem.pathSize];
 }
\ No newline at end of file
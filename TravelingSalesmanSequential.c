@@ -3,34 +3,100 @@
 #include <string.h>
 #include <limits.h>
 #include <stdlib.h>
-#include <time.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <omp.h>
 #include "Util.h"
+#include "EdgeLayout.h"
+#include "HeldKarp.h"
+#include "GraphIO.h"
+#include "SearchStats.h"
+#include "TspEngine.h"
+#include "LocalSearch.h"
+#include "GraphReduction.h"
 
 bool parse_args(int argc, char **argv);
 void init_globals();
-int get_path_length(int *p);
-void set_path_length(int *p, int len);
-int get_path_dist(int *p);
-void set_path_dist(int *p, int dist);
-int get_last_node(int *path);
-int *init_path();
-bool is_already_in_path(int *path, int node);
-void add_path(int *path);
-void remove_path(int *path);
+bool preprocess_graph();
+int solve_batch();
+int solve_local_search();
+void lower_open_bound(int bound);
+bool parse_bound_mode(char *arg);
+void warm_start();
+bool parse_engine(char *arg);
+bool solve_dp();
+void solve_best_first();
+int get_queue_key(int slot);
+void queue_push(int *path);
+void queue_pop(int *path);
 void solve();
-int add_node(int *path, int i);
-void remove_node(int *path, int w);
-void update_result(int *path);
+void search_stack();
+bool check_limits();
+void solve_parallel();
+int split_to_depth(int **frontier);
+void run_search_thread(int id);
+void answer_steal_request(int id);
+bool steal_work(int id);
+bool parse_child_order(char *arg);
+void report_best(int distance);
 
-bool prune = true;
+enum Engine {
+    ENGINE_DFS, ENGINE_INPLACE, ENGINE_DP, ENGINE_BEST, ENGINE_ILS
+};
+
+/*
+ * The search itself is the engine of TspEngine.h: the instance and the best tour live in problem,
+ * and every search thread runs its own search on it, with its own stack, dominance cache and counters.
+ * options holds the flags of the command line, -engine=inplace sets inPlace.
+ */
+TspOptions options;
+TspProblem problem;
+_Thread_local TspSearch search;
+enum Engine engine = ENGINE_DFS;
 bool verbose = false;
+int nThreads = 1;
+int splitDepth = 2;
+int queueCapacity = 1 << 16;
+char *batchFile;
+// local search restarts of -engine=ils, 0 runs them until the time limit
+int restarts = 8;
 
 int N;
 int *edgeMatrix;
-int bestDistance;
-int *bestPath;
-int *paths;
-int pathsInStack;
+/*
+ * Anytime mode: the search stops once options.timeLimit seconds or options.nodeLimit expansions are used up
+ * (0 is unlimited). The open paths it leaves behind bound every tour not yet seen, so min(openBound, bestDistance)
+ * is a proven lower bound on the optimum.
+ */
+double startTime;
+_Atomic bool stopRequested;
+_Atomic long limitNodes;
+_Thread_local long countedNodes;
+int openBound = INT_MAX;
+
+/*
+ * Multithreaded search: an idle thread posts its id into the stealRequest slot of a random victim,
+ * which hands over the shallowest entries of its stack through the thief's mailbox.
+ * The donor takes the thief out of idleThreads before publishing, so idleThreads == nThreads
+ * can only be observed once no work is left anywhere.
+ */
+typedef struct {
+    _Atomic int stealRequest;
+    _Atomic int mailboxCount;
+    int *mailbox;
+} SearchThread;
+
+SearchThread *searchThreads;
+_Atomic int idleThreads;
+
+/*
+ * Best-first engine: a binary min-heap of slot indices, ordered by the lower bound of the path
+ * record stored in each slot. Freed slots are kept on the freeSlots stack.
+ */
+int *queuePaths;
+int *queueHeap;
+int queueCount;
+int *freeSlots;
 
 
 static const int EXAMPLE_EDGES[][4] = {
@@ -41,167 +107,615 @@ static const int EXAMPLE_EDGES[][4] = {
 };
 #define EXAMPLE_N_NODES 4
 #define ERR_INVALID_ARGS (-1)
+#define ERR_ENGINE_FAILED (-3)
+#define STEAL_MAX_PATHS 8
+#define STEAL_POLL_INTERVAL 256
+#define LIMIT_POLL_INTERVAL 4096
+#define NO_REQUEST (-1)
+#define MAILBOX_EMPTY (-1)
 
 int main(int argc, char *argv[]) {
     if (!parse_args(argc, argv)) return ERR_INVALID_ARGS;
+    if (batchFile != NULL) return solve_batch();
+    if (!preprocess_graph()) return -1;
+    if (engine == ENGINE_ILS) return solve_local_search();
     print_edge_matrix(&edgeMatrix, N);
     init_globals();
     //MPI_Init(&argc, &argv);
-    clock_t t = clock();
-    solve();
-    t = clock() - t;
-    double timeTaken = ((double) t) / CLOCKS_PER_SEC;
+    startTime = omp_get_wtime();
+    if (engine == ENGINE_DP) {
+        if (nThreads > 1) omp_set_num_threads(nThreads);
+        if (!solve_dp()) return ERR_ENGINE_FAILED;
+    } else if (engine == ENGINE_BEST) {
+        if (options.warmStart) warm_start();
+        solve_best_first();
+    } else {
+        if (options.warmStart) warm_start();
+        if (nThreads > 1) {
+            solve_parallel();
+        } else {
+            solve();
+        }
+    }
+    double timeTaken = omp_get_wtime() - startTime;
+    SearchStats *stats = &search.stats;
+    // the parallel search accounts its threads' time itself
+    bool depthFirst = engine == ENGINE_DFS || engine == ENGINE_INPLACE;
+    if (nThreads == 1 || !depthFirst) stats->seconds[STAT_SEARCH_TIME] = timeTaken;
+    int bestDistance = problem.bestDistance;
     if (bestDistance == INT_MAX) {
-        printf("No solution possible for current graph!\n");
+        printf(stopRequested ? "No tour found before the search limit!\n" : "No solution possible for current graph!\n");
         return -1;
     }
     printf("\nBest path:\n");
-    print_path(true, bestPath, N + 1, bestDistance);
+    print_path(true, problem.bestPath, N + 1, bestDistance);
     printf("\nAlgorithm took %.3fs\n", timeTaken);
+    if (stopRequested) {
+        int lowerBound = openBound < bestDistance ? openBound : bestDistance;
+        printf("Stopped at the search limit, lower bound %d, optimality gap %.2f%%\n",
+               lowerBound, 100.0 * (bestDistance - lowerBound) / bestDistance);
+    }
+    if (engine != ENGINE_DP) {
+        printf("Expanded %ld nodes, pruned %ld\n", stats->counts[STAT_EXPANDED], get_pruned(stats));
+    }
+    print_stats(stats, depthFirst ? nThreads : 1);
     return 0;
 }
 
 bool parse_args(int argc, char *argv[]) {
     bool applyExample = argc >= 2 && strcmp(argv[1], "example") == 0;
+    bool applyFile = argc >= 3 && strcmp(argv[1], "file") == 0;
+    bool applyBatch = argc >= 3 && strcmp(argv[1], "batch") == 0;
+    tsp_default_options(&options);
     if (applyExample) {
-        edgeMatrix = (int *) EXAMPLE_EDGES;
+        // a copy, the preprocessing writes to the matrix
+        allocate_int_array(&edgeMatrix, EXAMPLE_N_NODES, EXAMPLE_N_NODES);
+        memcpy(edgeMatrix, EXAMPLE_EDGES, sizeof(EXAMPLE_EDGES));
         N = EXAMPLE_N_NODES;
     } else if (argc < 3) {
         printf("Not enough arguments!\n");
-        printf("Usage: <program> <nNodes> <%%population> [-noprune] [-verbose]\n");
-        printf("Alternative: <program> \"example\" [-noprune] [-verbose]\n");
+        printf("Usage: <program> <nNodes> <%%population> [-noprune] [-bound=none|partial|minout|ap] [-engine=dfs|inplace|dp|best|ils] [-queue=Q] [-cache-mb=M] [-restarts=R] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-time-limit=S] [-node-limit=N] [-threads=K] [-split-depth=D] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index] [-write-binary=<file>] [-verbose]\n");
+        printf("Alternative: <program> \"example\" [-noprune] [-bound=none|partial|minout|ap] [-engine=dfs|inplace|dp|best|ils] [-queue=Q] [-cache-mb=M] [-restarts=R] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-time-limit=S] [-node-limit=N] [-threads=K] [-split-depth=D] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index] [-write-binary=<file>] [-verbose]\n");
+        printf("Alternative: <program> \"file\" <TSPLIB or binary matrix file> [-noprune] [-bound=none|partial|minout|ap] [-engine=dfs|inplace|dp|best|ils] [-queue=Q] [-cache-mb=M] [-restarts=R] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-time-limit=S] [-node-limit=N] [-threads=K] [-split-depth=D] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index] [-write-binary=<file>] [-verbose]\n");
+        printf("Alternative: <program> \"batch\" <concatenated binary matrices> [-noprune] [-bound=none|partial|minout|ap] [-engine=dfs|inplace] [-cache-mb=M] [-nowarmstart] [-nosymmetry] [-noreduce] [-reach] [-nosimd] [-time-limit=S] [-node-limit=N] [-threads=K] [-layout=auto|dense|dense16|dense8|sparse] [-order=cheapest|index]\n");
         return false;
+    } else if (applyFile) {
+        edgeMatrix = load_graph_file(argv[2], &N);
+        if (edgeMatrix == NULL) return false;
+    } else if (applyBatch) {
+        batchFile = argv[2];
     } else {
         char *endptr;
         int nodesArg = (int) strtol(argv[1], &endptr, 10);
         int populationArg = (int) strtol(argv[2], &endptr, 10);
         N = nodesArg;
-        edgeMatrix = get_random_edge_matrix(nodesArg, populationArg);
+        edgeMatrix = get_random_edge_matrix(nodesArg, populationArg, omp_get_max_threads());
     }
     for (int a = 0; a < argc; a++) {
         if (strcmp(argv[a], "-noprune") == 0) {
-            prune = false;
+            options.boundMode = TSP_BOUND_NONE;
+        } else if (strcmp(argv[a], "-nowarmstart") == 0) {
+            options.warmStart = false;
+        } else if (strcmp(argv[a], "-nosymmetry") == 0) {
+            options.symmetryBreaking = false;
+        } else if (strcmp(argv[a], "-nosimd") == 0) {
+            options.simd = false;
+        } else if (strcmp(argv[a], "-noreduce") == 0) {
+            options.reduceGraph = false;
+        } else if (strcmp(argv[a], "-reach") == 0) {
+            options.reachChecks = true;
+        } else if (strncmp(argv[a], "-bound=", 7) == 0) {
+            if (!parse_bound_mode(argv[a] + 7)) return false;
+        } else if (strncmp(argv[a], "-engine=", 8) == 0) {
+            if (!parse_engine(argv[a] + 8)) return false;
+        } else if (strncmp(argv[a], "-threads=", 9) == 0) {
+            nThreads = (int) strtol(argv[a] + 9, NULL, 10);
+        } else if (strncmp(argv[a], "-split-depth=", 13) == 0) {
+            splitDepth = (int) strtol(argv[a] + 13, NULL, 10);
+        } else if (strncmp(argv[a], "-time-limit=", 12) == 0) {
+            options.timeLimit = strtod(argv[a] + 12, NULL);
+        } else if (strncmp(argv[a], "-node-limit=", 12) == 0) {
+            options.nodeLimit = strtol(argv[a] + 12, NULL, 10);
+        } else if (strncmp(argv[a], "-cache-mb=", 10) == 0) {
+            options.cacheMegabytes = (int) strtol(argv[a] + 10, NULL, 10);
+        } else if (strncmp(argv[a], "-restarts=", 10) == 0) {
+            restarts = (int) strtol(argv[a] + 10, NULL, 10);
+        } else if (strncmp(argv[a], "-queue=", 7) == 0) {
+            queueCapacity = (int) strtol(argv[a] + 7, NULL, 10);
+        } else if (strncmp(argv[a], "-write-binary=", 14) == 0) {
+            if (batchFile != NULL) {
+                printf("-write-binary needs a single instance!\n");
+                return false;
+            }
+            if (!write_binary_matrix(argv[a] + 14, edgeMatrix, N)) return false;
+        } else if (strncmp(argv[a], "-layout=", 8) == 0) {
+            if (!parse_edge_layout(argv[a] + 8, &options.layout)) return false;
+        } else if (strncmp(argv[a], "-order=", 7) == 0) {
+            if (!parse_child_order(argv[a] + 7)) return false;
         } else if (strcmp(argv[a], "-verbose") == 0) {
             verbose = true;
         }
     }
+    options.inPlace = engine == ENGINE_INPLACE;
+    if (nThreads < 1 || splitDepth < 0 || queueCapacity < 1 || options.cacheMegabytes < 0) {
+        printf("Invalid thread count, split depth, queue or cache size!\n");
+        return false;
+    }
+    if (options.timeLimit < 0 || options.nodeLimit < 0) {
+        printf("Invalid search limit!\n");
+        return false;
+    }
+    if (batchFile != NULL && engine != ENGINE_DFS && engine != ENGINE_INPLACE) {
+        printf("Batch mode needs the dfs or inplace engine!\n");
+        return false;
+    }
+    if (options.boundMode == TSP_BOUND_AP && engine != ENGINE_DFS && engine != ENGINE_BEST) {
+        printf("The ap bound needs the dfs or best engine!\n");
+        return false;
+    }
+    if (options.reachChecks && engine != ENGINE_DFS && engine != ENGINE_BEST) {
+        printf("-reach needs the dfs or best engine!\n");
+        return false;
+    }
+    if (engine == ENGINE_DP && (options.timeLimit > 0 || options.nodeLimit > 0)) {
+        printf("Search limits need the dfs or best engine!\n");
+        return false;
+    }
+    if (engine == ENGINE_ILS && (options.nodeLimit > 0 || restarts < 0 || (restarts == 0 && options.timeLimit == 0))) {
+        printf("The ils engine needs a restart count or a time limit, and no node limit!\n");
+        return false;
+    }
     return true;
 }
 
+/*
+ * Batch mode: solves every instance of a batch file with the reentrant solver of TspSolver.h.
+ * The threads take whole instances, each reusing its own context, so -threads=K solves K instances at a time.
+ * Every instance is searched by a single thread, which gets the whole -cache-mb.
+ */
+int solve_batch() {
+    int count;
+    int *nodeCounts;
+    int *matrices = load_binary_batch(batchFile, &count, &nodeCounts);
+    if (matrices == NULL) return ERR_INVALID_ARGS;
+    size_t *matrixOffsets = malloc(count * sizeof(size_t));
+    size_t *tourOffsets = malloc(count * sizeof(size_t));
+    size_t matrixEntries = 0, tourEntries = 0;
+    for (int i = 0; i < count; i++) {
+        matrixOffsets[i] = matrixEntries;
+        tourOffsets[i] = tourEntries;
+        matrixEntries += (size_t) nodeCounts[i] * nodeCounts[i];
+        tourEntries += nodeCounts[i] + 1;
+    }
+    int *tours = malloc(tourEntries * sizeof(int));
+    TspResult *results = malloc(count * sizeof(TspResult));
+    startTime = omp_get_wtime();
+#pragma omp parallel num_threads(nThreads)
+    {
+        TspContext *context = tsp_create_context();
+#pragma omp for schedule(dynamic)
+        for (int i = 0; i < count; i++) {
+            tsp_solve(context, &matrices[matrixOffsets[i]], nodeCounts[i], &options, &results[i]);
+            // the tour belongs to the context, which the next instance overwrites
+            memcpy(&tours[tourOffsets[i]], results[i].tour, (nodeCounts[i] + 1) * sizeof(int));
+            results[i].tour = &tours[tourOffsets[i]];
+        }
+        tsp_free_context(context);
+    }
+    double timeTaken = omp_get_wtime() - startTime;
+    SearchStats total;
+    reset_stats(&total);
+    for (int i = 0; i < count; i++) {
+        add_stats(&total, &results[i].stats);
+        if (results[i].distance == INT_MAX) {
+            printf("Instance %d: %s\n", i, results[i].stopped ? "no tour found before the search limit" : "no solution possible");
+            continue;
+        }
+        printf("Instance %d: ", i);
+        print_path(true, (int *) results[i].tour, nodeCounts[i] + 1, results[i].distance);
+        if (results[i].stopped) printf("Instance %d: stopped at the search limit, lower bound %d\n", i, results[i].lowerBound);
+    }
+    printf("\nSolved %d instances in %.3fs, %.1f instances per second\n", count, timeTaken, count / timeTaken);
+    printf("Expanded %ld nodes, pruned %ld\n", total.counts[STAT_EXPANDED], get_pruned(&total));
+    print_stats(&total, nThreads);
+    free(results);
+    free(tours);
+    free(tourOffsets);
+    free(matrixOffsets);
+    free(nodeCounts);
+    free(matrices);
+    return 0;
+}
+
+/*
+ * Large instances: the threads run local search restarts (see LocalSearch.h) until restarts are done
+ * or the time limit is up, checked between restarts. Odd restarts kick the best tour so far instead of
+ * building a new one. Nothing is proven, so the result is only the best tour found.
+ */
+int solve_local_search() {
+    int *bestTour = malloc((N + 1) * sizeof(int));
+    int bestDistance = INT_MAX;
+    _Atomic int nextRestart = 0;
+    SearchStats total;
+    reset_stats(&total);
+    startTime = omp_get_wtime();
+#pragma omp parallel num_threads(nThreads)
+    {
+        LocalSearch *localSearch = local_search_create(edgeMatrix, N);
+        int *tour = malloc((N + 1) * sizeof(int));
+        SearchStats *stats = &search.stats;
+        reset_stats(stats);
+        while (!check_limits()) {
+            int restart = atomic_fetch_add(&nextRestart, 1);
+            if (restarts > 0 && restart >= restarts) break;
+            unsigned int seed = (unsigned int) restart + 1;
+            bool fresh = restart % 2 == 0;
+#pragma omp critical(best_path)
+            {
+                if (bestDistance == INT_MAX) fresh = true;
+                if (!fresh) memcpy(tour, bestTour, (N + 1) * sizeof(int));
+            }
+            int distance = local_search_run(localSearch, tour, fresh, &seed);
+            stats->counts[STAT_TOURS]++;
+#pragma omp critical(best_path)
+            if (distance < bestDistance) {
+                memcpy(bestTour, tour, (N + 1) * sizeof(int));
+                bestDistance = distance;
+                stats->counts[STAT_BOUND_IMPROVEMENTS]++;
+                report_best(distance);
+            }
+        }
+        stats->seconds[STAT_SEARCH_TIME] = omp_get_wtime() - startTime;
+#pragma omp critical(stats)
+        add_stats(&total, stats);
+        free(tour);
+        local_search_free(localSearch);
+    }
+    double timeTaken = omp_get_wtime() - startTime;
+    if (bestDistance == INT_MAX) {
+        printf("No tour found by local search!\n");
+        free(bestTour);
+        return -1;
+    }
+    printf("\nBest path:\n");
+    print_path(true, bestTour, N + 1, bestDistance);
+    printf("\nAlgorithm took %.3fs\n", timeTaken);
+    printf("Local search over %ld restarts, not proven optimal\n", total.counts[STAT_TOURS]);
+    print_stats(&total, nThreads);
+    free(bestTour);
+    return 0;
+}
 
+bool parse_bound_mode(char *arg) {
+    if (strcmp(arg, "none") == 0) {
+        options.boundMode = TSP_BOUND_NONE;
+    } else if (strcmp(arg, "partial") == 0) {
+        options.boundMode = TSP_BOUND_PARTIAL;
+    } else if (strcmp(arg, "minout") == 0) {
+        options.boundMode = TSP_BOUND_MINOUT;
+    } else if (strcmp(arg, "ap") == 0) {
+        options.boundMode = TSP_BOUND_AP;
+    } else {
+        printf("Unknown bound mode '%s'!\n", arg);
+        return false;
+    }
+    return true;
+}
+
+bool parse_child_order(char *arg) {
+    if (strcmp(arg, "cheapest") == 0) {
+        options.cheapestFirst = true;
+    } else if (strcmp(arg, "index") == 0) {
+        options.cheapestFirst = false;
+    } else {
+        printf("Unknown child order '%s'!\n", arg);
+        return false;
+    }
+    return true;
+}
+
+
+bool parse_engine(char *arg) {
+    if (strcmp(arg, "dfs") == 0) {
+        engine = ENGINE_DFS;
+    } else if (strcmp(arg, "inplace") == 0) {
+        engine = ENGINE_INPLACE;
+    } else if (strcmp(arg, "dp") == 0) {
+        engine = ENGINE_DP;
+    } else if (strcmp(arg, "best") == 0) {
+        engine = ENGINE_BEST;
+    } else if (strcmp(arg, "ils") == 0) {
+        engine = ENGINE_ILS;
+    } else {
+        printf("Unknown engine '%s'!\n", arg);
+        return false;
+    }
+    return true;
+}
+
+// the main thread's search also expands the split levels of the parallel search and the best-first queue
 void init_globals() {
-    allocate_int_array(&paths, N * (N - 1) / 2, N + 3);
-    pathsInStack = 0;
-    allocate_int_array(&bestPath, 1, N + 3);
-    bestDistance = INT_MAX;
+    tsp_init_problem(&problem, edgeMatrix, N, &options);
+    problem.reportBest = report_best;
+    problem.verbose = verbose;
+    tsp_init_search(&search, &problem, STEAL_MAX_PATHS, nThreads);
 }
 
-int get_path_length(int *p) {
-    return p[N + 1];
+// drops the edges no tour can use from edgeMatrix, false if the graph has no tour at all
+bool preprocess_graph() {
+    if (!options.reduceGraph) return true;
+    GraphReduction reduction;
+    if (!reduce_graph(edgeMatrix, N, &reduction)) {
+        printf("No solution possible for current graph!\n");
+        return false;
+    }
+    char message[96];
+    snprintf(message, sizeof(message), "preprocessing dropped %d edges, %d edges are forced.",
+             reduction.droppedEdges, reduction.forcedEdges);
+    LOG_INFO(log_msg(verbose, message));
+    return true;
 }
 
-void set_path_length(int *p, int len) {
-    p[N + 1] = len;
+// folds the bound of what a stopped search left open into openBound
+void lower_open_bound(int bound) {
+#pragma omp critical(open_bound)
+    if (bound < openBound) openBound = bound;
 }
 
-int get_path_dist(int *p) {
-    return p[N + 2];
+void warm_start() {
+    int distance = tsp_warm_start(&problem);
+    if (distance == INT_MAX) {
+        LOG_INFO(log_msg(verbose, "no feasible warm start tour found."));
+        return;
+    }
+    report_best(distance);
+    LOG_INFO(log_msg(verbose, "warm start tour:"));
+    LOG_INFO(print_path(verbose, problem.bestPath, N + 1, distance));
 }
 
-void set_path_dist(int *p, int dist) {
-    p[N + 2] = dist;
+void solve() {
+    tsp_init_path(&problem, search.path);
+    tsp_push_path(&search, search.path);
+    search_stack();
+    if (stopRequested) lower_open_bound(tsp_get_search_open_bound(&search));
 }
 
-int get_last_node(int *path) {
-    return path[get_path_length(path) - 1];
+// expands the stack of the calling thread until it is empty or a search limit is reached
+void search_stack() {
+    while (tsp_has_work(&search) && !check_limits()) tsp_expand(&search, LIMIT_POLL_INTERVAL);
 }
 
-int *init_path() {
-    int *initialPath;
-    allocate_int_array(&initialPath, 1, N + 3);
-    initialPath[0] = 0;
-    set_path_length(initialPath, 1);
-    set_path_dist(initialPath, 0);
-    return initialPath;
+// called between batches of expansions, so every thread notices a stop within one batch
+bool check_limits() {
+    if (stopRequested) return true;
+    if (options.timeLimit > 0 && omp_get_wtime() - startTime >= options.timeLimit) stopRequested = true;
+    if (options.nodeLimit > 0) {
+        long expanded = search.stats.counts[STAT_EXPANDED] - countedNodes;
+        countedNodes += expanded;
+        if (atomic_fetch_add(&limitNodes, expanded) + expanded >= options.nodeLimit) stopRequested = true;
+    }
+    return stopRequested;
 }
 
-bool is_already_in_path(int *path, int node) {
-    for (int i = 0; i < get_path_length(path); i++)
-        if (path[i] == node) return true;
-    return false;
+/*
+ * Expands the tree breadth-first down to splitDepth and deals the frontier round-robin
+ * onto the stacks of nThreads search threads, which then balance the load by work stealing.
+ */
+void solve_parallel() {
+    int pathSize = problem.pathSize;
+    int *frontier;
+    int frontierSize = split_to_depth(&frontier);
+    int share = (frontierSize + nThreads - 1) / nThreads;
+    searchThreads = malloc(nThreads * sizeof(SearchThread));
+    for (int t = 0; t < nThreads; t++) {
+        allocate_int_array(&searchThreads[t].mailbox, STEAL_MAX_PATHS, pathSize);
+        atomic_init(&searchThreads[t].stealRequest, NO_REQUEST);
+        atomic_init(&searchThreads[t].mailboxCount, MAILBOX_EMPTY);
+    }
+    atomic_init(&idleThreads, 0);
+    SearchStats total = search.stats;
+    limitNodes = total.counts[STAT_EXPANDED];
+#pragma omp parallel num_threads(nThreads)
+    {
+        int id = omp_get_thread_num();
+        tsp_init_search(&search, &problem, STEAL_MAX_PATHS + share, nThreads);
+        for (int f = id; f < frontierSize; f += nThreads) tsp_push_path(&search, &frontier[f * pathSize]);
+        countedNodes = 0;
+        double t = omp_get_wtime();
+        run_search_thread(id);
+        search.stats.seconds[STAT_SEARCH_TIME] = omp_get_wtime() - t - search.stats.seconds[STAT_IDLE_TIME];
+#pragma omp critical(stats)
+        add_stats(&total, &search.stats);
+        if (id != 0) tsp_free_search(&search);
+    }
+    free(frontier);
+    search.pathsInStack = 0;
+    search.stats = total;
+    for (int t = 0; t < nThreads; t++) {
+        // paths a donor handed over after the thief had already stopped
+        int count = searchThreads[t].mailboxCount;
+        if (stopRequested && count > 0) lower_open_bound(tsp_get_open_bound(&problem, searchThreads[t].mailbox, count));
+        free(searchThreads[t].mailbox);
+    }
+    free(searchThreads);
 }
 
-void add_path(int *path) {
-    memcpy(&paths[pathsInStack * (N + 3)], path, (N + 3) * sizeof(int));
-    pathsInStack++;
+// returns the number of open paths after splitDepth levels, pruned against the current best distance
+int split_to_depth(int **frontier) {
+    int pathSize = problem.pathSize;
+    int depth = splitDepth < N - 2 ? splitDepth : N - 2;
+    int *current;
+    allocate_int_array(&current, 1, pathSize);
+    tsp_init_path(&problem, current);
+    int currentCount = 1;
+    int *path = search.path;
+    for (int level = 0; level < depth; level++) {
+        int *next;
+        int nextCount = 0;
+        allocate_int_array(&next, currentCount * (N - level - 1) + 1, pathSize);
+        for (int p = 0; p < currentCount; p++) {
+            memcpy(path, &current[p * pathSize], pathSize * sizeof(int));
+            search.stats.counts[STAT_EXPANDED]++;
+            for (int i = 0; i < N; i++) {
+                int w = tsp_add_node(&search, path, i);
+                if (w < 0) continue;
+                memcpy(&next[nextCount * pathSize], path, pathSize * sizeof(int));
+                nextCount++;
+                tsp_remove_node(&problem, path, w);
+            }
+        }
+        free(current);
+        current = next;
+        currentCount = nextCount;
+    }
+    *frontier = current;
+    return currentCount;
 }
 
-void remove_path(int *path) {
-    pathsInStack--;
-    memcpy(path, &paths[pathsInStack * (N + 3)], (N + 3) * sizeof(int));
+void run_search_thread(int id) {
+    while (true) {
+        if (tsp_has_work(&search)) {
+            if (check_limits()) break;
+            tsp_expand(&search, STEAL_POLL_INTERVAL);
+            answer_steal_request(id);
+            continue;
+        }
+        atomic_fetch_add(&idleThreads, 1);
+        double idleStart = omp_get_wtime();
+        bool stolen = steal_work(id);
+        search.stats.seconds[STAT_IDLE_TIME] += omp_get_wtime() - idleStart;
+        if (!stolen) break;
+    }
+    if (stopRequested) lower_open_bound(tsp_get_search_open_bound(&search));
 }
 
+void answer_steal_request(int id) {
+    int thief = atomic_load_explicit(&searchThreads[id].stealRequest, memory_order_acquire);
+    if (thief == NO_REQUEST) return;
+    int count = tsp_donate_paths(&search, searchThreads[thief].mailbox, STEAL_MAX_PATHS);
+    if (count > 0) atomic_fetch_sub(&idleThreads, 1);
+    atomic_store_explicit(&searchThreads[id].stealRequest, NO_REQUEST, memory_order_relaxed);
+    atomic_store_explicit(&searchThreads[thief].mailboxCount, count, memory_order_release);
+}
 
-void solve() {
-    int *path = init_path();
-    add_path(path);
-    while (pathsInStack > 0) {
-        remove_path(path);
-        print_path(verbose, path, get_path_length(path), get_path_dist(path));
-        if (get_path_length(path) == N) {
-            update_result(path);
+// called while idle, returns false once every thread is idle and the search is finished or stopped
+bool steal_work(int id) {
+    unsigned int seed = (unsigned int) id + 1;
+    while (atomic_load(&idleThreads) < nThreads && !stopRequested) {
+        answer_steal_request(id);
+        int victim = (int) (rand_r(&seed) % (nThreads - 1));
+        if (victim >= id) victim++;
+        int expected = NO_REQUEST;
+        atomic_store_explicit(&searchThreads[id].mailboxCount, MAILBOX_EMPTY, memory_order_relaxed);
+        if (!atomic_compare_exchange_strong(&searchThreads[victim].stealRequest, &expected, id)) {
+            sched_yield();
             continue;
         }
-        for (int i = 0; i < N; i++) {
-            int w = add_node(path, i);
-            if (w < 0) continue;
-            add_path(path);
-            remove_node(path, w);
+        int count;
+        while ((count = atomic_load_explicit(&searchThreads[id].mailboxCount, memory_order_acquire)) == MAILBOX_EMPTY) {
+            answer_steal_request(id);
+            if (atomic_load(&idleThreads) == nThreads || stopRequested) return false;
+            sched_yield();
+        }
+        if (count > 0) {
+            // the donor already took this thread out of idleThreads
+            for (int p = 0; p < count; p++) tsp_push_path(&search, &searchThreads[id].mailbox[p * problem.pathSize]);
+            return true;
         }
     }
-    free(path);
+    return false;
 }
 
-int add_node(int *path, int i) {
-    int currPathNode = get_last_node(path);
-    if (i == currPathNode) return -1;
-    if (is_already_in_path(path, i)) return -1;
-    int dist = edgeMatrix[currPathNode * N + i];
-    if (dist == 0) return -1;
-    int newDist = get_path_dist(path) + dist;
-    if (prune && newDist > bestDistance) {
-        log_prune(verbose, newDist, bestDistance);
-        return -1;
+bool solve_dp() {
+    int distance;
+    int *tour = malloc((N + 1) * sizeof(int));
+    bool solved = held_karp_solve(edgeMatrix, N, tour, &distance);
+    if (solved && distance != INT_MAX) tsp_set_best_tour(&problem, tour, distance);
+    free(tour);
+    return solved;
+}
+
+/*
+ * Always expands the open path with the lowest bound next, holding at most queueCapacity of them.
+ * Children that no longer fit are searched depth-first on the spot, which keeps the search exact.
+ * Once the lowest bound exceeds the best tour, so does every other queued path.
+ */
+void solve_best_first() {
+    int pathSize = problem.pathSize;
+    allocate_int_array(&queuePaths, queueCapacity, pathSize);
+    allocate_int_array(&queueHeap, 1, queueCapacity);
+    allocate_int_array(&freeSlots, 1, queueCapacity);
+    for (int slot = 0; slot < queueCapacity; slot++) freeSlots[slot] = queueCapacity - 1 - slot;
+    queueCount = 0;
+    int *path;
+    allocate_int_array(&path, 1, pathSize);
+    tsp_init_path(&problem, path);
+    queue_push(path);
+    while (queueCount > 0 && !check_limits()) {
+        queue_pop(path);
+        int lowerBound = tsp_get_search_bound(&problem, path);
+        if (options.boundMode != TSP_BOUND_NONE && lowerBound > problem.bestDistance) {
+            search.stats.counts[STAT_PRUNED_BOUND] += queueCount + 1;
+            break;
+        }
+        tsp_expand_path(&search, path);
+        while (search.pathsInStack > 0 && queueCount < queueCapacity) {
+            tsp_pop_path(&search, path);
+            queue_push(path);
+        }
+        search_stack();
+    }
+    if (stopRequested) {
+        lower_open_bound(tsp_get_search_open_bound(&search));
+        for (int q = 0; q < queueCount; q++) lower_open_bound(tsp_get_path_bound(&problem, &queuePaths[queueHeap[q] * pathSize]));
     }
-    int pathLength = get_path_length(path);
-    path[pathLength] = i;
-    set_path_length(path, pathLength + 1);
-    set_path_dist(path, newDist);
-    return dist;
+    free(path);
+    free(queuePaths);
+    free(queueHeap);
+    free(freeSlots);
 }
 
-void remove_node(int *path, int w) {
-    set_path_dist(path, get_path_dist(path) - w);
-    set_path_length(path, get_path_length(path) - 1);
+int get_queue_key(int slot) {
+    return tsp_get_search_bound(&problem, &queuePaths[slot * problem.pathSize]);
 }
 
-void update_result(int *path) {
-    int currPathNode = get_last_node(path);
-    int distTo0 = edgeMatrix[currPathNode * N + 0];
-    if (distTo0 == 0) {
-        log_msg(verbose, "missing way back to 0!");
-        return;
+void queue_push(int *path) {
+    int pathSize = problem.pathSize;
+    int slot = freeSlots[queueCapacity - 1 - queueCount];
+    memcpy(&queuePaths[slot * pathSize], path, pathSize * sizeof(int));
+    int key = get_queue_key(slot);
+    int i = queueCount++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (get_queue_key(queueHeap[parent]) <= key) break;
+        queueHeap[i] = queueHeap[parent];
+        i = parent;
     }
-    path[N] = 0;
-    int totalDist = get_path_dist(path) + distTo0;
-    set_path_dist(path, totalDist);
-    set_path_length(path, N + 1);
-    print_path(verbose, path, get_path_length(path), get_path_dist(path));
-    log_curr_best_dist(verbose, totalDist, bestDistance);
-    if (totalDist < bestDistance) {
-        log_msg(verbose, "new best!");
-        bestDistance = totalDist;
-        memcpy(bestPath, path, (N + 3) * sizeof(int));
+    queueHeap[i] = slot;
+}
+
+void queue_pop(int *path) {
+    int pathSize = problem.pathSize;
+    int top = queueHeap[0];
+    memcpy(path, &queuePaths[top * pathSize], pathSize * sizeof(int));
+    queueCount--;
+    freeSlots[queueCapacity - 1 - queueCount] = top;
+    if (queueCount == 0) return;
+    int last = queueHeap[queueCount];
+    int key = get_queue_key(last);
+    int i = 0;
+    while (2 * i + 1 < queueCount) {
+        int child = 2 * i + 1;
+        if (child + 1 < queueCount && get_queue_key(queueHeap[child + 1]) < get_queue_key(queueHeap[child])) child++;
+        if (key <= get_queue_key(queueHeap[child])) break;
+        queueHeap[i] = queueHeap[child];
+        i = child;
     }
+    queueHeap[i] = last;
 }
 
+// streams every improvement, so a stopped or killed run still shows what it had found
+void report_best(int distance) {
+    printf("New best %d after %.3fs\n", distance, omp_get_wtime() - startTime);
+    fflush(stdout);
+}
@@ -0,0 +1,144 @@
+#ifndef TRAVELINGSALESMAN_TSPENGINE_H
+#define TRAVELINGSALESMAN_TSPENGINE_H
+
+#include <stddef.h>
+#include <omp.h>
+#include "TspSolver.h"
+#include "GraphReduction.h"
+#include "Assignment.h"
+
+/*
+ * The branch and bound engine of both solvers, without globals.
+ * A TspProblem holds what all searches of one instance share: the matrix in its layout, the bounds of every node
+ * and the best tour so far. A TspSearch is one search thread on it, with its own DFS stack, in-place state,
+ * dominance cache and counters. The solvers run one search per thread and hand work between them by moving path
+ * records from one stack to another, tsp_solve runs a single search to the end.
+ */
+
+/*
+ * Path records hold the nodes, then length, distance, remaining bound and the estimated size of the subtree below
+ * the path (0 unless a caller sets it), then the visited bitset with its padding bits set, and with
+ * TSP_BOUND_AP the assignment block of Assignment.h.
+ */
+#define TSP_OFFSET_PATH_LEN 1
+#define TSP_OFFSET_PATH_DIST 2
+#define TSP_OFFSET_PATH_REMAINING 3
+#define TSP_OFFSET_PATH_ESTIMATE 4
+#define TSP_OFFSET_VISITED 5
+
+typedef struct {
+    TspOptions options;
+    const int *edgeMatrix;
+    int n;
+    int visitedWords;
+    int pathSize;
+    int assignmentOffset;
+    EdgeLayout edgeLayout;
+    bool symmetric;
+    // what an unvisited node contributes to the remaining bound of a path
+    int *minOutEdge;
+    int *secondEdge;
+    int *remainingWeight;
+    int maxSecondEdge;
+    // off on complete graphs, which always close the unvisited nodes into a tour
+    bool reachChecks;
+    ReachMasks reachMasks;
+    _Atomic int bestDistance;
+    int *bestPath;
+    omp_lock_t bestPathLock;
+    // called with the lock held for every tour better than the best path, may be NULL
+    void (*reportBest)(int distance);
+    // trace output, prefixed with the rank unless it is negative
+    bool verbose;
+    int rank;
+    // node count the buffers are allocated for
+    int capacity;
+} TspProblem;
+
+typedef struct {
+    TspProblem *problem;
+    int *paths;
+    int pathsInStack;
+    int stackCapacity;
+    // the record expanded paths are popped into
+    int *path;
+    SearchStats stats;
+    /*
+     * In-place engine: the subtree below a root is searched on one mutable path. Per depth it keeps the position
+     * of the next candidate in the row it walks (placeCursor) and the edge that led there (placeWeight),
+     * so descending and backtracking touch O(1) data and the stack only holds roots waiting for their search.
+     * Level 0 is the root, level d ends in placePath[placeRootLength + d - 1]; placeDepth -1 means no active subtree.
+     */
+    int *placePath;
+    int *placeCursor;
+    int *placeWeight;
+    int *placeExport;
+    int placeRootLength;
+    int placeDepth;
+    /*
+     * Dominance cache: paths over the same visited set that end in the same node have the same completions,
+     * so one longer than a path already pushed cannot lead to a better tour. An entry holds the visited words,
+     * the last node, the path length and the shortest distance seen. Of the two entries of a bucket the first
+     * keeps the shortest path, which heads the largest subtree, and the second takes whatever comes.
+     */
+    int cacheEntrySize;
+    int *cacheEntries;
+    size_t cacheMask;
+    AssignmentWork *assignmentWork;
+    unsigned int *reachScratch;
+    // node count, stack and cache sizes the buffers are allocated for
+    int capacity;
+    size_t stackInts;
+    size_t cacheInts;
+} TspSearch;
+
+void tsp_default_options(TspOptions *options);
+
+void tsp_init_problem(TspProblem *problem, const int *edgeMatrix, int n, const TspOptions *options);
+void tsp_free_problem(TspProblem *problem);
+int tsp_warm_start(TspProblem *problem);
+void tsp_set_best_tour(TspProblem *problem, const int *tour, int distance);
+void tsp_lower_best_distance(TspProblem *problem, int distance);
+bool tsp_is_preferred_tour(const TspProblem *problem, const int *path, const int *other);
+void tsp_init_path(const TspProblem *problem, int *path);
+int tsp_get_path_bound(const TspProblem *problem, const int *path);
+int tsp_get_search_bound(const TspProblem *problem, const int *path);
+int tsp_get_open_bound(const TspProblem *problem, const int *records, int count);
+bool tsp_is_open_child(const TspProblem *problem, const int *path, int i, int dist);
+void tsp_append_node(const TspProblem *problem, int *path, int i, int dist);
+void tsp_remove_node(const TspProblem *problem, int *path, int w);
+
+void tsp_init_search(TspSearch *search, TspProblem *problem, int extraPaths, int cacheShare);
+void tsp_free_search(TspSearch *search);
+void tsp_reserve_paths(TspSearch *search, int capacity);
+void tsp_push_path(TspSearch *search, const int *path);
+void tsp_pop_path(TspSearch *search, int *path);
+bool tsp_has_work(const TspSearch *search);
+void tsp_expand(TspSearch *search, long budget);
+void tsp_expand_path(TspSearch *search, int *path);
+void tsp_push_children(TspSearch *search, int *path);
+int tsp_add_node(TspSearch *search, int *path, int i);
+int tsp_donate_paths(TspSearch *search, int *records, int max);
+int tsp_get_search_open_bound(TspSearch *search);
+
+static inline int tsp_get_path_length(const TspProblem *problem, const int *path) {
+    return path[problem->n + TSP_OFFSET_PATH_LEN];
+}
+
+static inline int tsp_get_path_dist(const TspProblem *problem, const int *path) {
+    return path[problem->n + TSP_OFFSET_PATH_DIST];
+}
+
+static inline int tsp_get_path_estimate(const TspProblem *problem, const int *path) {
+    return path[problem->n + TSP_OFFSET_PATH_ESTIMATE];
+}
+
+static inline void tsp_set_path_estimate(const TspProblem *problem, int *path, int estimate) {
+    path[problem->n + TSP_OFFSET_PATH_ESTIMATE] = estimate;
+}
+
+static inline int tsp_get_last_node(const TspProblem *problem, const int *path) {
+    return path[tsp_get_path_length(problem, path) - 1];
+}
+
+#endif //TRAVELINGSALESMAN_TSPENGINE_H
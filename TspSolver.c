@@ -0,0 +1,957 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <stdatomic.h>
+#include "TspEngine.h"
+#include "Util.h"
+#include "Heuristic.h"
+
+#define BITS_PER_WORD 32
+#define LIMIT_POLL_INTERVAL 4096
+#define CACHE_WAYS 2
+#define CACHE_LAST 0
+#define CACHE_LENGTH 1
+#define CACHE_DIST 2
+
+struct TspContext {
+    TspProblem problem;
+    TspSearch search;
+    // the matrix after preprocessing
+    int *reducedMatrix;
+    int matrixCapacity;
+};
+
+void tsp_default_options(TspOptions *options) {
+    options->boundMode = TSP_BOUND_PARTIAL;
+    options->layout = LAYOUT_AUTO;
+    options->cheapestFirst = true;
+    options->warmStart = true;
+    options->symmetryBreaking = true;
+    options->simd = true;
+    options->reduceGraph = true;
+    options->reachChecks = false;
+    options->inPlace = false;
+    options->cacheMegabytes = 16;
+    options->timeLimit = 0;
+    options->nodeLimit = 0;
+}
+
+static void set_path_length(const TspProblem *p, int *path, int len) {
+    path[p->n + TSP_OFFSET_PATH_LEN] = len;
+}
+
+static void set_path_dist(const TspProblem *p, int *path, int dist) {
+    path[p->n + TSP_OFFSET_PATH_DIST] = dist;
+}
+
+static int get_path_remaining(const TspProblem *p, const int *path) {
+    return path[p->n + TSP_OFFSET_PATH_REMAINING];
+}
+
+static void set_path_remaining(const TspProblem *p, int *path, int remaining) {
+    path[p->n + TSP_OFFSET_PATH_REMAINING] = remaining;
+}
+
+static bool is_already_in_path(const TspProblem *p, const int *path, int node) {
+    unsigned int word = (unsigned int) path[p->n + TSP_OFFSET_VISITED + node / BITS_PER_WORD];
+    return (word >> (node % BITS_PER_WORD)) & 1u;
+}
+
+static void set_visited(const TspProblem *p, int *path, int node) {
+    unsigned int *word = (unsigned int *) &path[p->n + TSP_OFFSET_VISITED + node / BITS_PER_WORD];
+    *word |= 1u << (node % BITS_PER_WORD);
+}
+
+static void clear_visited(const TspProblem *p, int *path, int node) {
+    unsigned int *word = (unsigned int *) &path[p->n + TSP_OFFSET_VISITED + node / BITS_PER_WORD];
+    *word &= ~(1u << (node % BITS_PER_WORD));
+}
+
+static unsigned int get_unvisited_bits(const TspProblem *p, const int *path, int word) {
+    return ~(unsigned int) path[p->n + TSP_OFFSET_VISITED + word];
+}
+
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+static void trace_path(const TspProblem *p, int *path) {
+    int length = tsp_get_path_length(p, path), dist = tsp_get_path_dist(p, path);
+    if (p->rank < 0) print_path(p->verbose, path, length, dist);
+    else printt_path(p->verbose, p->rank, path, length, dist);
+}
+
+static void trace_msg(const TspProblem *p, char *message) {
+    if (p->rank < 0) log_msg(p->verbose, message);
+    else logt_msg(p->verbose, p->rank, message);
+}
+
+static void trace_prune(const TspProblem *p, int lowerBound) {
+    if (p->rank < 0) log_prune(p->verbose, lowerBound, p->bestDistance);
+    else logt_prune(p->verbose, p->rank, lowerBound, p->bestDistance);
+}
+
+static void trace_curr_best_dist(const TspProblem *p, int totalDist) {
+    if (p->rank < 0) log_curr_best_dist(p->verbose, totalDist, p->bestDistance);
+    else logt_curr_best_dist(p->verbose, p->rank, totalDist, p->bestDistance);
+}
+#endif
+
+// the largest record of an instance of n nodes, the one with the assignment block
+static int get_max_path_size(int n) {
+    return n + TSP_OFFSET_VISITED + (n + BITS_PER_WORD - 1) / BITS_PER_WORD + get_assignment_size(n);
+}
+
+/*
+ * Every node has to be left exactly once more for each unvisited node (plus the last node),
+ * so the sum of their cheapest outgoing edges never overestimates the remaining tour.
+ * On symmetric instances every unvisited node is also entered once, so it contributes half of its
+ * two cheapest edges, and the two ends of the path half of their cheapest one.
+ * Nodes without enough edges contribute 0 to keep the bound admissible.
+ */
+static void init_min_out_edges(TspProblem *p) {
+    int n = p->n;
+    p->maxSecondEdge = 0;
+    for (int row = 0; row < n; row++) {
+        int min = 0, second = 0;
+        for (int col = 0; col < n; col++) {
+            int dist = p->edgeMatrix[row * n + col];
+            if (dist == 0 || row == col) continue;
+            if (min == 0 || dist < min) {
+                second = min;
+                min = dist;
+            } else if (second == 0 || dist < second) {
+                second = dist;
+            }
+        }
+        p->minOutEdge[row] = min;
+        p->secondEdge[row] = second;
+        if (second > p->maxSecondEdge) p->maxSecondEdge = second;
+        p->remainingWeight[row] = p->symmetric ? min + second : min;
+    }
+}
+
+static void free_problem_buffers(TspProblem *p) {
+    free(p->minOutEdge);
+    free(p->secondEdge);
+    free(p->remainingWeight);
+    free(p->bestPath);
+}
+
+/*
+ * A problem starts zeroed, a later init reuses the buffers of the earlier one. The matrix is not copied and has to
+ * outlive the problem. Leaves the trace off and reportBest unset.
+ */
+void tsp_init_problem(TspProblem *p, const int *edgeMatrix, int n, const TspOptions *options) {
+    if (p->capacity == 0) {
+        omp_init_lock(&p->bestPathLock);
+    } else {
+        free_edge_layout(&p->edgeLayout);
+        if (p->reachChecks) free_reach_masks(&p->reachMasks);
+    }
+    if (n > p->capacity) {
+        free_problem_buffers(p);
+        allocate_int_array(&p->minOutEdge, 1, n);
+        allocate_int_array(&p->secondEdge, 1, n);
+        allocate_int_array(&p->remainingWeight, 1, n);
+        allocate_int_array(&p->bestPath, 1, get_max_path_size(n));
+        p->capacity = n;
+    }
+    p->options = *options;
+    p->edgeMatrix = edgeMatrix;
+    p->n = n;
+    p->visitedWords = (n + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    p->pathSize = n + TSP_OFFSET_VISITED + p->visitedWords;
+    p->assignmentOffset = p->pathSize;
+    if (options->boundMode == TSP_BOUND_AP) p->pathSize += get_assignment_size(n);
+    p->symmetric = options->symmetryBreaking && n >= 3 && is_symmetric_matrix(edgeMatrix, n);
+    init_min_out_edges(p);
+    init_edge_layout(&p->edgeLayout, edgeMatrix, n, options->layout, options->cheapestFirst);
+    if (!options->simd) p->edgeLayout.rowKernel = ROW_KERNEL_SCALAR;
+    p->reachChecks = options->reachChecks && !is_complete_graph(edgeMatrix, n);
+    if (p->reachChecks) init_reach_masks(&p->reachMasks, edgeMatrix, n);
+    p->bestDistance = INT_MAX;
+    set_path_dist(p, p->bestPath, INT_MAX);
+    p->reportBest = NULL;
+    p->verbose = false;
+    p->rank = -1;
+}
+
+void tsp_free_problem(TspProblem *p) {
+    if (p->capacity == 0) return;
+    free_edge_layout(&p->edgeLayout);
+    if (p->reachChecks) free_reach_masks(&p->reachMasks);
+    free_problem_buffers(p);
+    omp_destroy_lock(&p->bestPathLock);
+    memset(p, 0, sizeof(TspProblem));
+}
+
+// a symmetric tour is only searched in the orientation that visits node 1 before node 2
+static bool keeps_orientation(const TspProblem *p, const int *path, int i) {
+    return i != 2 || is_already_in_path(p, path, 1);
+}
+
+// turns a tour found outside the search into the orientation the search explores
+static void orient_tour(const TspProblem *p, int *tour) {
+    if (!p->symmetric) return;
+    int pos = 1;
+    while (tour[pos] != 1 && tour[pos] != 2) pos++;
+    if (tour[pos] == 1) return;
+    for (int a = 1, b = p->n - 1; a < b; a++, b--) {
+        int tmp = tour[a];
+        tour[a] = tour[b];
+        tour[b] = tmp;
+    }
+}
+
+// seeds the best tour with the heuristic one, returns its distance or INT_MAX if the heuristic found none
+int tsp_warm_start(TspProblem *p) {
+    int distance = heuristic_tour(p->edgeMatrix, p->n, p->bestPath);
+    if (distance == INT_MAX) return INT_MAX;
+    orient_tour(p, p->bestPath);
+    set_path_length(p, p->bestPath, p->n + 1);
+    set_path_dist(p, p->bestPath, distance);
+    tsp_lower_best_distance(p, distance);
+    return distance;
+}
+
+// makes the n + 1 nodes of tour the best tour, for tours found by other engines
+void tsp_set_best_tour(TspProblem *p, const int *tour, int distance) {
+    memcpy(p->bestPath, tour, (p->n + 1) * sizeof(int));
+    set_path_length(p, p->bestPath, p->n + 1);
+    set_path_dist(p, p->bestPath, distance);
+    tsp_lower_best_distance(p, distance);
+}
+
+void tsp_lower_best_distance(TspProblem *p, int distance) {
+    int current = p->bestDistance;
+    while (distance < current && !atomic_compare_exchange_weak(&p->bestDistance, &current, distance));
+}
+
+void tsp_init_path(const TspProblem *p, int *path) {
+    int n = p->n;
+    memset(&path[n + TSP_OFFSET_VISITED], 0, p->visitedWords * sizeof(int));
+    // padding bits past the last node count as visited so they are never expanded
+    for (int node = n; node < p->visitedWords * BITS_PER_WORD; node++) {
+        set_visited(p, path, node);
+    }
+    path[0] = 0;
+    set_visited(p, path, 0);
+    set_path_length(p, path, 1);
+    set_path_dist(p, path, 0);
+    tsp_set_path_estimate(p, path, 0);
+    int remaining = 0;
+    for (int node = 1; node < n; node++) remaining += p->remainingWeight[node];
+    set_path_remaining(p, path, remaining);
+    // solved for no length, so the first bound solves the assignment from scratch
+    if (p->options.boundMode == TSP_BOUND_AP) path[p->assignmentOffset + ASSIGNMENT_LENGTH] = -1;
+}
+
+// remaining covers the unvisited nodes, last is the node the path ends in
+static int get_minout_bound(const TspProblem *p, int dist, int remaining, int last) {
+    if (p->symmetric) return dist + (remaining + p->minOutEdge[last] + p->minOutEdge[0] + 1) / 2;
+    return dist + remaining + p->minOutEdge[last];
+}
+
+static int get_lower_bound(const TspProblem *p, int newDist, int remaining, int last) {
+    if (p->options.boundMode != TSP_BOUND_MINOUT) return newDist;
+    return get_minout_bound(p, newDist, remaining, last);
+}
+
+// lower bound every child of path respects, without the edge leading to the child
+static int get_children_bound(const TspProblem *p, const int *path) {
+    int dist = tsp_get_path_dist(p, path);
+    int remaining = get_path_remaining(p, path);
+    if (p->options.boundMode != TSP_BOUND_MINOUT) return dist;
+    if (!p->symmetric) return dist + remaining;
+    // a child i leaves remaining - secondEdge[i] + minOutEdge[0] >= 0 to halve
+    int halves = remaining - p->maxSecondEdge + p->minOutEdge[0];
+    return dist + (halves > 0 ? halves + 1 : 0) / 2;
+}
+
+// bound of every tour through a record from the block it carries, whether solved for the record or its parent
+static long get_record_assignment_bound(const TspProblem *p, const int *path) {
+    const int *block = &path[p->assignmentOffset];
+    int n = p->n;
+    int length = tsp_get_path_length(p, path);
+    if (block[ASSIGNMENT_LENGTH] == length) {
+        return block[ASSIGNMENT_COST] == INT_MAX ? LONG_MAX : tsp_get_path_dist(p, path) + (long) block[ASSIGNMENT_COST];
+    }
+    if (block[ASSIGNMENT_LENGTH] != length - 1) return 0;
+    int previous = path[length - 2];
+    int last = tsp_get_last_node(p, path);
+    int edge = p->edgeMatrix[previous * n + last];
+    return get_assignment_child_bound(block, n, tsp_get_path_dist(p, path) - edge, previous, last, edge);
+}
+
+// brings the assignment of an expanded path up to date, false if it already rules out every tour through the path
+static bool is_assignment_open(TspSearch *s, int *path) {
+    const TspProblem *p = s->problem;
+    int *block = &path[p->assignmentOffset];
+    assignment_refresh(p->edgeMatrix, p->n, path, tsp_get_path_length(p, path), &path[p->n + TSP_OFFSET_VISITED],
+                       block, s->assignmentWork);
+    return get_record_assignment_bound(p, path) <= p->bestDistance;
+}
+
+// bound of the child of path ending in i, from the assignment of path (LONG_MAX if it has none)
+static long get_assignment_bound(TspSearch *s, int *path, int i, int dist) {
+    const TspProblem *p = s->problem;
+    int *block = &path[p->assignmentOffset];
+    assignment_refresh(p->edgeMatrix, p->n, path, tsp_get_path_length(p, path), &path[p->n + TSP_OFFSET_VISITED],
+                       block, s->assignmentWork);
+    return get_assignment_child_bound(block, p->n, tsp_get_path_dist(p, path), tsp_get_last_node(p, path), i, dist);
+}
+
+// the strongest bound of every tour through path, whichever mode the search prunes with
+int tsp_get_path_bound(const TspProblem *p, const int *path) {
+    int bound = get_minout_bound(p, tsp_get_path_dist(p, path), get_path_remaining(p, path), tsp_get_last_node(p, path));
+    if (p->options.boundMode != TSP_BOUND_AP) return bound;
+    long assignment = get_record_assignment_bound(p, path);
+    if (assignment <= bound) return bound;
+    return assignment > INT_MAX ? INT_MAX : (int) assignment;
+}
+
+// the bound the search prunes path with under its bound mode, the key of a best-first queue
+int tsp_get_search_bound(const TspProblem *p, const int *path) {
+    if (p->options.boundMode == TSP_BOUND_AP) return tsp_get_path_bound(p, path);
+    return get_lower_bound(p, tsp_get_path_dist(p, path), get_path_remaining(p, path), tsp_get_last_node(p, path));
+}
+
+// the lowest bound of count open records, INT_MAX if there are none
+int tsp_get_open_bound(const TspProblem *p, const int *records, int count) {
+    int bound = INT_MAX;
+    for (int r = 0; r < count; r++) {
+        int pathBound = tsp_get_path_bound(p, &records[r * p->pathSize]);
+        if (pathBound < bound) bound = pathBound;
+    }
+    return bound;
+}
+
+// whether the search would accept the child i of path over an edge of length dist, without counting the prune
+bool tsp_is_open_child(const TspProblem *p, const int *path, int i, int dist) {
+    if (is_already_in_path(p, path, i)) return false;
+    if (p->symmetric && !keeps_orientation(p, path, i)) return false;
+    if (p->options.boundMode == TSP_BOUND_NONE) return true;
+    int remaining = get_path_remaining(p, path) - p->remainingWeight[i];
+    return get_lower_bound(p, tsp_get_path_dist(p, path) + dist, remaining, i) <= p->bestDistance;
+}
+
+static void append_node(const TspProblem *p, int *path, int i, int newDist, int remaining) {
+    int pathLength = tsp_get_path_length(p, path);
+    path[pathLength] = i;
+    set_visited(p, path, i);
+    set_path_length(p, path, pathLength + 1);
+    set_path_dist(p, path, newDist);
+    set_path_remaining(p, path, remaining);
+}
+
+// appends i over an edge of length dist without bounding it or looking it up in a dominance cache
+void tsp_append_node(const TspProblem *p, int *path, int i, int dist) {
+    append_node(p, path, i, tsp_get_path_dist(p, path) + dist, get_path_remaining(p, path) - p->remainingWeight[i]);
+}
+
+// takes the last node off path, which was reached over an edge of length w
+void tsp_remove_node(const TspProblem *p, int *path, int w) {
+    int lastNode = tsp_get_last_node(p, path);
+    clear_visited(p, path, lastNode);
+    set_path_remaining(p, path, get_path_remaining(p, path) + p->remainingWeight[lastNode]);
+    set_path_dist(p, path, tsp_get_path_dist(p, path) - w);
+    set_path_length(p, path, tsp_get_path_length(p, path) - 1);
+}
+
+// gives the search its share of the cache, none if it is turned off
+static void init_cache(TspSearch *s, int share) {
+    const TspProblem *p = s->problem;
+    int n = p->n;
+    s->cacheEntrySize = p->visitedWords + CACHE_DIST + 1;
+    size_t buckets = ((size_t) p->options.cacheMegabytes << 20) / share / (CACHE_WAYS * s->cacheEntrySize * sizeof(int));
+    // small instances have fewer keys than that, and every bucket touched costs a page fault
+    if (n < 32 && buckets > ((size_t) n << (n - 1)) / CACHE_WAYS) buckets = ((size_t) n << (n - 1)) / CACHE_WAYS;
+    if (buckets == 0) {
+        free(s->cacheEntries);
+        s->cacheEntries = NULL;
+        s->cacheInts = 0;
+        return;
+    }
+    // a power of two, so the hash is masked
+    while ((buckets & (buckets - 1)) != 0) buckets &= buckets - 1;
+    s->cacheMask = buckets - 1;
+    size_t ints = buckets * CACHE_WAYS * s->cacheEntrySize;
+    if (ints > s->cacheInts) {
+        free(s->cacheEntries);
+        s->cacheEntries = calloc(ints, sizeof(int));
+        s->cacheInts = ints;
+    } else {
+        memset(s->cacheEntries, 0, ints * sizeof(int));
+    }
+}
+
+static void free_search_buffers(TspSearch *s) {
+    free(s->path);
+    free(s->placePath);
+    free(s->placeExport);
+    free(s->placeCursor);
+    free(s->placeWeight);
+    free(s->reachScratch);
+    assignment_free_work(s->assignmentWork);
+    s->assignmentWork = NULL;
+}
+
+/*
+ * A search starts zeroed, a later init reuses the buffers of the earlier one. Its stack holds the children of one
+ * path per level plus extraPaths, with the in-place engine only extraPaths. cacheShare is the number of searches
+ * the cache of the problem is split between.
+ */
+void tsp_init_search(TspSearch *s, TspProblem *p, int extraPaths, int cacheShare) {
+    int n = p->n;
+    s->problem = p;
+    if (n > s->capacity) {
+        free_search_buffers(s);
+        int maxPathSize = get_max_path_size(n);
+        allocate_int_array(&s->path, 1, maxPathSize);
+        allocate_int_array(&s->placePath, 1, maxPathSize);
+        allocate_int_array(&s->placeExport, 1, maxPathSize);
+        allocate_int_array(&s->placeCursor, 1, n);
+        allocate_int_array(&s->placeWeight, 1, n);
+        s->reachScratch = malloc(2 * p->visitedWords * sizeof(unsigned int));
+        s->capacity = n;
+    }
+    if (p->options.boundMode == TSP_BOUND_AP && s->assignmentWork == NULL) {
+        s->assignmentWork = assignment_create_work(s->capacity);
+    }
+    s->pathsInStack = 0;
+    tsp_reserve_paths(s, (p->options.inPlace ? 0 : n * (n - 1) / 2) + extraPaths);
+    s->placeDepth = -1;
+    reset_stats(&s->stats);
+    init_cache(s, cacheShare);
+}
+
+void tsp_free_search(TspSearch *s) {
+    free_search_buffers(s);
+    free(s->paths);
+    free(s->cacheEntries);
+    memset(s, 0, sizeof(TspSearch));
+}
+
+// grows the stack to hold capacity records, keeping the ones it holds
+void tsp_reserve_paths(TspSearch *s, int capacity) {
+    int pathSize = s->problem->pathSize;
+    size_t ints = (size_t) capacity * pathSize;
+    if (ints > s->stackInts) {
+        int *paths;
+        allocate_int_array(&paths, capacity, pathSize);
+        if (s->pathsInStack > 0) memcpy(paths, s->paths, (size_t) s->pathsInStack * pathSize * sizeof(int));
+        free(s->paths);
+        s->paths = paths;
+        s->stackInts = ints;
+    }
+    s->stackCapacity = (int) (s->stackInts / pathSize);
+}
+
+static void add_path(TspSearch *s, const int *path) {
+    int pathSize = s->problem->pathSize;
+    memcpy(&s->paths[s->pathsInStack * pathSize], path, pathSize * sizeof(int));
+    s->pathsInStack++;
+}
+
+static void remove_path(TspSearch *s, int *path) {
+    int pathSize = s->problem->pathSize;
+    s->pathsInStack--;
+    memcpy(path, &s->paths[s->pathsInStack * pathSize], pathSize * sizeof(int));
+}
+
+void tsp_push_path(TspSearch *s, const int *path) {
+    add_path(s, path);
+}
+
+void tsp_pop_path(TspSearch *s, int *path) {
+    remove_path(s, path);
+}
+
+// the in-place engine may still be inside a subtree with an empty stack
+bool tsp_has_work(const TspSearch *s) {
+    return s->pathsInStack > 0 || s->placeDepth >= 0;
+}
+
+// false for a path whose unvisited nodes cannot be closed into a tour any more, counted as a reach prune
+static bool can_complete_path(TspSearch *s, const int *path) {
+    const TspProblem *p = s->problem;
+    if (!p->reachChecks
+        || can_complete(&p->reachMasks, tsp_get_last_node(p, path), &path[p->n + TSP_OFFSET_VISITED], s->reachScratch)) {
+        return true;
+    }
+    s->stats.counts[STAT_PRUNED_REACH]++;
+    return false;
+}
+
+/*
+ * Looks the freshly extended path up in the dominance cache and records it unless it is dominated.
+ * An equally long path is not dominated, so tsp_is_preferred_tour still sees every shortest tour.
+ * Empty entries have no visited bits, which never matches a path since node 0 is always visited.
+ */
+static bool is_dominated(TspSearch *s, const int *path) {
+    const TspProblem *p = s->problem;
+    int visitedWords = p->visitedWords, entrySize = s->cacheEntrySize;
+    const int *visited = &path[p->n + TSP_OFFSET_VISITED];
+    int last = tsp_get_last_node(p, path);
+    int length = tsp_get_path_length(p, path);
+    int dist = tsp_get_path_dist(p, path);
+    unsigned int hash = (unsigned int) last * 0x9E3779B1u;
+    for (int word = 0; word < visitedWords; word++) hash = (hash ^ (unsigned int) visited[word]) * 0x85EBCA6Bu;
+    hash ^= hash >> 16;
+    int *bucket = &s->cacheEntries[(hash & s->cacheMask) * CACHE_WAYS * entrySize];
+    for (int way = 0; way < CACHE_WAYS; way++) {
+        int *entry = &bucket[way * entrySize];
+        if (entry[visitedWords + CACHE_LAST] != last || memcmp(entry, visited, visitedWords * sizeof(int)) != 0) {
+            continue;
+        }
+        if (dist > entry[visitedWords + CACHE_DIST]) return true;
+        entry[visitedWords + CACHE_DIST] = dist;
+        return false;
+    }
+    int *entry = &bucket[entrySize];
+    if (bucket[visitedWords + CACHE_LENGTH] == 0 || length <= bucket[visitedWords + CACHE_LENGTH]) {
+        memcpy(entry, bucket, entrySize * sizeof(int));
+        entry = bucket;
+    }
+    memcpy(entry, visited, visitedWords * sizeof(int));
+    entry[visitedWords + CACHE_LAST] = last;
+    entry[visitedWords + CACHE_LENGTH] = length;
+    entry[visitedWords + CACHE_DIST] = dist;
+    return false;
+}
+
+// appends the unvisited node i, reached over an existing edge of length dist, unless the bound prunes it
+static int extend_path(TspSearch *s, int *path, int i, int dist) {
+    const TspProblem *p = s->problem;
+    enum TspBoundMode boundMode = p->options.boundMode;
+    int newDist = tsp_get_path_dist(p, path) + dist;
+    int remaining = get_path_remaining(p, path) - p->remainingWeight[i];
+    if (p->symmetric && !keeps_orientation(p, path, i)) {
+        s->stats.counts[STAT_PRUNED_SYMMETRY]++;
+        return -1;
+    }
+    if (boundMode != TSP_BOUND_NONE) {
+        int lowerBound = get_lower_bound(p, newDist, remaining, i);
+        if (lowerBound > p->bestDistance) {
+            LOG_TRACE(trace_prune(p, lowerBound));
+            s->stats.counts[STAT_PRUNED_BOUND]++;
+            return -1;
+        }
+    }
+    if (boundMode == TSP_BOUND_AP && get_assignment_bound(s, path, i, dist) > p->bestDistance) {
+        s->stats.counts[STAT_PRUNED_BOUND]++;
+        return -1;
+    }
+    append_node(p, path, i, newDist, remaining);
+    // with fewer than two nodes left the subtree is too small to be worth an entry
+    if (s->cacheEntries != NULL && tsp_get_path_length(p, path) + 2 <= p->n && is_dominated(s, path)) {
+        tsp_remove_node(p, path, dist);
+        s->stats.counts[STAT_PRUNED_DOMINANCE]++;
+        return -1;
+    }
+    return dist;
+}
+
+// appends i if it is unvisited, reached over an existing edge and survives the bound, returns the edge or -1
+int tsp_add_node(TspSearch *s, int *path, int i) {
+    const TspProblem *p = s->problem;
+    if (is_already_in_path(p, path, i)) return -1;
+    int dist = get_edge_dist(&p->edgeLayout, tsp_get_last_node(p, path), i);
+    if (dist == 0) return -1;
+    return extend_path(s, path, i, dist);
+}
+
+/*
+ * Pushes the children of path most expensive first, so the cheapest one is expanded next.
+ * The out-edges are sorted by weight, so the first one that alone exceeds what the bound leaves
+ * ends the row: every later neighbour costs at least as much.
+ */
+static void push_cheapest_children(TspSearch *s, int *path) {
+    const TspProblem *p = s->problem;
+    const EdgeLayout *layout = &p->edgeLayout;
+    int from = tsp_get_last_node(p, path);
+    int start = layout->byWeightStart[from];
+    int end = layout->byWeightStart[from + 1];
+    if (p->options.boundMode != TSP_BOUND_NONE) {
+        long budget = (long) p->bestDistance - get_children_bound(p, path);
+        int cut = start;
+        while (cut < end && layout->byWeightWeights[cut] <= budget) cut++;
+        // counting the unvisited nodes behind the cut would cost the walk it saves, so a cut counts once
+        if (cut < end) s->stats.counts[STAT_PRUNED_CUT]++;
+        end = cut;
+    }
+    for (int e = end - 1; e >= start; e--) {
+        int i = layout->byWeightNeighbours[e];
+        if (is_already_in_path(p, path, i)) continue;
+        int w = extend_path(s, path, i, layout->byWeightWeights[e]);
+        if (w < 0) continue;
+        add_path(s, path);
+        tsp_remove_node(p, path, w);
+    }
+}
+
+/*
+ * Pushes every child of path that survives the bound onto the stack, in increasing node order unless the cheapest
+ * ones go first. The sparse layout only walks the existing out-edges of the last node, the dense ones filter the
+ * row of the last node a word at a time with the row kernel of the layout.
+ */
+void tsp_push_children(TspSearch *s, int *path) {
+    const TspProblem *p = s->problem;
+    const EdgeLayout *layout = &p->edgeLayout;
+    if (p->options.cheapestFirst) {
+        push_cheapest_children(s, path);
+        return;
+    }
+    int from = tsp_get_last_node(p, path);
+    if (layout->kind == LAYOUT_SPARSE) {
+        for (int e = layout->rowStart[from]; e < layout->rowStart[from + 1]; e++) {
+            int i = layout->neighbours[e];
+            if (is_already_in_path(p, path, i)) continue;
+            int w = extend_path(s, path, i, layout->weights[e]);
+            if (w < 0) continue;
+            add_path(s, path);
+            tsp_remove_node(p, path, w);
+        }
+        return;
+    }
+    long budget = p->options.boundMode != TSP_BOUND_NONE ? (long) p->bestDistance - get_children_bound(p, path) : LONG_MAX;
+    for (int word = 0; word < p->visitedWords; word++) {
+        unsigned int over;
+        unsigned int candidates = get_row_candidates(layout, from, word, get_unvisited_bits(p, path, word), budget, &over);
+        // children whose edge alone exceeds the budget, extend_path would have pruned each of them
+        s->stats.counts[STAT_PRUNED_BOUND] += __builtin_popcount(over);
+        while (candidates != 0) {
+            int i = word * BITS_PER_WORD + __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+            int w = extend_path(s, path, i, get_edge_dist(layout, from, i));
+            if (w < 0) continue;
+            add_path(s, path);
+            tsp_remove_node(p, path, w);
+        }
+    }
+}
+
+/*
+ * Among tours of equal distance the lexicographically largest one wins. That is the one the
+ * sequential DFS reaches first, so the result does not depend on the thread count or warm start.
+ */
+bool tsp_is_preferred_tour(const TspProblem *p, const int *path, const int *other) {
+    for (int i = 1; i < p->n; i++) {
+        if (path[i] != other[i]) return path[i] > other[i];
+    }
+    return false;
+}
+
+static void update_result(TspSearch *s, int *path) {
+    TspProblem *p = s->problem;
+    int n = p->n;
+    int distTo0 = p->edgeMatrix[tsp_get_last_node(p, path) * n + 0];
+    if (distTo0 == 0) {
+        LOG_TRACE(trace_msg(p, "missing way back to 0!"));
+        s->stats.counts[STAT_NO_RETURN]++;
+        return;
+    }
+    s->stats.counts[STAT_TOURS]++;
+    path[n] = 0;
+    int totalDist = tsp_get_path_dist(p, path) + distTo0;
+    set_path_dist(p, path, totalDist);
+    set_path_length(p, path, n + 1);
+    LOG_TRACE(trace_path(p, path));
+    LOG_TRACE(trace_curr_best_dist(p, totalDist));
+    if (totalDist > p->bestDistance) return;
+    omp_set_lock(&p->bestPathLock);
+    int currBest = tsp_get_path_dist(p, p->bestPath);
+    if (totalDist < currBest) {
+        s->stats.counts[STAT_BOUND_IMPROVEMENTS]++;
+        if (p->reportBest != NULL) p->reportBest(totalDist);
+    }
+    if (totalDist < currBest || (totalDist == currBest && tsp_is_preferred_tour(p, path, p->bestPath))) {
+        LOG_TRACE(trace_msg(p, "new best!"));
+        memcpy(p->bestPath, path, p->pathSize * sizeof(int));
+        tsp_lower_best_distance(p, totalDist);
+    }
+    omp_unset_lock(&p->bestPathLock);
+}
+
+// expands a path taken off a stack or queue: a tour is recorded, any other path pushes its children
+void tsp_expand_path(TspSearch *s, int *path) {
+    const TspProblem *p = s->problem;
+    s->stats.counts[STAT_EXPANDED]++;
+    LOG_TRACE(trace_path(p, path));
+    if (tsp_get_path_length(p, path) == p->n) {
+        update_result(s, path);
+        return;
+    }
+    if (p->options.boundMode == TSP_BOUND_AP && !is_assignment_open(s, path)) {
+        s->stats.counts[STAT_PRUNED_BOUND]++;
+        return;
+    }
+    if (!can_complete_path(s, path)) return;
+    tsp_push_children(s, path);
+}
+
+// update_result completes the tour in the record, which the in-place path has to get back
+static void record_leaf(TspSearch *s, int *path) {
+    const TspProblem *p = s->problem;
+    int dist = tsp_get_path_dist(p, path);
+    update_result(s, path);
+    set_path_length(p, path, p->n);
+    set_path_dist(p, path, dist);
+}
+
+// the cheapest order walks its row up, the index order walks down like the stack DFS pops it
+static int get_row_start(const TspProblem *p, const int *path) {
+    const EdgeLayout *layout = &p->edgeLayout;
+    int from = tsp_get_last_node(p, path);
+    if (p->options.cheapestFirst) return layout->byWeightStart[from];
+    if (layout->kind == LAYOUT_SPARSE) return layout->rowStart[from + 1] - 1;
+    return p->n - 1;
+}
+
+// appends the next child of the level's node that survives the bound and returns its edge, -1 once none is left
+static int next_child(TspSearch *s, int *path, int level) {
+    const TspProblem *p = s->problem;
+    const EdgeLayout *layout = &p->edgeLayout;
+    int from = tsp_get_last_node(p, path);
+    int *cursor = &s->placeCursor[level];
+    long budget = p->options.boundMode != TSP_BOUND_NONE ? (long) p->bestDistance - get_children_bound(p, path) : LONG_MAX;
+    if (p->options.cheapestFirst) {
+        int end = layout->byWeightStart[from + 1];
+        while (*cursor < end) {
+            int e = (*cursor)++;
+            int i = layout->byWeightNeighbours[e];
+            if (is_already_in_path(p, path, i)) continue;
+            if (layout->byWeightWeights[e] > budget) {
+                s->stats.counts[STAT_PRUNED_CUT]++;
+                *cursor = end;
+                return -1;
+            }
+            int w = extend_path(s, path, i, layout->byWeightWeights[e]);
+            if (w >= 0) return w;
+        }
+        return -1;
+    }
+    if (layout->kind == LAYOUT_SPARSE) {
+        while (*cursor >= layout->rowStart[from]) {
+            int e = (*cursor)--;
+            int i = layout->neighbours[e];
+            if (is_already_in_path(p, path, i)) continue;
+            int w = extend_path(s, path, i, layout->weights[e]);
+            if (w >= 0) return w;
+        }
+        return -1;
+    }
+    while (*cursor >= 0) {
+        int word = *cursor / BITS_PER_WORD;
+        // the unvisited nodes of the cursor's word, up to the cursor
+        unsigned int unvisited = get_unvisited_bits(p, path, word) & (~0u >> (BITS_PER_WORD - 1 - *cursor % BITS_PER_WORD));
+        unsigned int over;
+        unsigned int candidates = get_row_candidates(layout, from, word, unvisited, budget, &over);
+        if (candidates == 0) {
+            s->stats.counts[STAT_PRUNED_BOUND] += __builtin_popcount(over);
+            *cursor = word * BITS_PER_WORD - 1;
+            continue;
+        }
+        int bit = BITS_PER_WORD - 1 - __builtin_clz(candidates);
+        // the cursor passes the children above bit, whose edges exceed the budget
+        s->stats.counts[STAT_PRUNED_BOUND] += __builtin_popcount(over >> bit);
+        int i = word * BITS_PER_WORD + bit;
+        *cursor = i - 1;
+        int w = extend_path(s, path, i, get_edge_dist(layout, from, i));
+        if (w >= 0) return w;
+    }
+    return -1;
+}
+
+/*
+ * Expands up to budget nodes, or all of them if budget is negative, taking the next root from the stack
+ * whenever a subtree is exhausted. Every candidate is bounded when its turn comes instead of when its
+ * parent is expanded, so it already sees the tours found in the subtrees of its older siblings.
+ */
+static void expand_in_place(TspSearch *s, long budget) {
+    const TspProblem *p = s->problem;
+    int *path = s->placePath;
+    while (budget != 0) {
+        if (s->placeDepth < 0) {
+            if (s->pathsInStack == 0) return;
+            remove_path(s, path);
+            budget--;
+            s->stats.counts[STAT_EXPANDED]++;
+            LOG_TRACE(trace_path(p, path));
+            if (tsp_get_path_length(p, path) == p->n) {
+                record_leaf(s, path);
+                continue;
+            }
+            s->placeRootLength = tsp_get_path_length(p, path);
+            s->placeDepth = 0;
+            s->placeCursor[0] = get_row_start(p, path);
+            continue;
+        }
+        int w = next_child(s, path, s->placeDepth);
+        if (w < 0) {
+            if (s->placeDepth > 0) tsp_remove_node(p, path, s->placeWeight[s->placeDepth]);
+            s->placeDepth--;
+            continue;
+        }
+        budget--;
+        s->stats.counts[STAT_EXPANDED]++;
+        LOG_TRACE(trace_path(p, path));
+        if (tsp_get_path_length(p, path) == p->n) {
+            record_leaf(s, path);
+            tsp_remove_node(p, path, w);
+            continue;
+        }
+        s->placeDepth++;
+        s->placeWeight[s->placeDepth] = w;
+        s->placeCursor[s->placeDepth] = get_row_start(p, path);
+    }
+}
+
+// pops and expands up to budget paths from the stack, or all of them if budget is negative
+void tsp_expand(TspSearch *s, long budget) {
+    if (s->problem->options.inPlace) {
+        expand_in_place(s, budget);
+        return;
+    }
+    int *path = s->path;
+    while (s->pathsInStack > 0 && budget-- != 0) {
+        remove_path(s, path);
+        tsp_expand_path(s, path);
+    }
+}
+
+static bool is_level_pending(const TspSearch *s, int level) {
+    const TspProblem *p = s->problem;
+    const EdgeLayout *layout = &p->edgeLayout;
+    int from = s->placePath[s->placeRootLength + level - 1];
+    if (p->options.cheapestFirst) return s->placeCursor[level] < layout->byWeightStart[from + 1];
+    if (layout->kind == LAYOUT_SPARSE) return s->placeCursor[level] >= layout->rowStart[from];
+    return s->placeCursor[level] >= 0;
+}
+
+// copies the in-place path cut back to the node of level
+static void get_prefix(const TspSearch *s, int *record, int level) {
+    memcpy(record, s->placePath, s->problem->pathSize * sizeof(int));
+    for (int d = s->placeDepth; d > level; d--) tsp_remove_node(s->problem, record, s->placeWeight[d]);
+}
+
+/*
+ * Turns up to max pending children of the shallowest level above the current node into path records,
+ * so they can be handed out while this search keeps the subtree it is in. Returns how many it wrote.
+ */
+static int export_frontier(TspSearch *s, int *records, int max) {
+    int pathSize = s->problem->pathSize;
+    int count = 0;
+    for (int level = 0; level < s->placeDepth && count == 0; level++) {
+        get_prefix(s, s->placeExport, level);
+        int w;
+        while (count < max && (w = next_child(s, s->placeExport, level)) >= 0) {
+            memcpy(&records[count * pathSize], s->placeExport, pathSize * sizeof(int));
+            tsp_remove_node(s->problem, s->placeExport, w);
+            count++;
+        }
+    }
+    return count;
+}
+
+/*
+ * Hands up to max of the shallowest open paths over into records and returns how many: half of the stack from
+ * its bottom, since the top entry is about to be expanded anyway, or with the in-place engine and no more than
+ * one stacked path the pending children of its shallowest level.
+ */
+int tsp_donate_paths(TspSearch *s, int *records, int max) {
+    int pathSize = s->problem->pathSize;
+    int count = s->pathsInStack / 2;
+    if (count > max) count = max;
+    if (count > 0) {
+        memcpy(records, s->paths, count * pathSize * sizeof(int));
+        s->pathsInStack -= count;
+        memmove(s->paths, &s->paths[count * pathSize], s->pathsInStack * pathSize * sizeof(int));
+        return count;
+    }
+    return s->problem->options.inPlace ? export_frontier(s, records, max) : 0;
+}
+
+// bound of every tour a stopped search has not seen yet, INT_MAX if it had nothing left
+int tsp_get_search_open_bound(TspSearch *s) {
+    int bound = tsp_get_open_bound(s->problem, s->paths, s->pathsInStack);
+    // every tour the in-place subtree has not seen runs through its shallowest level with pending children
+    for (int level = 0; level <= s->placeDepth; level++) {
+        if (!is_level_pending(s, level)) continue;
+        get_prefix(s, s->placeExport, level);
+        int levelBound = tsp_get_path_bound(s->problem, s->placeExport);
+        if (levelBound < bound) bound = levelBound;
+        break;
+    }
+    return bound;
+}
+
+static double get_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+TspContext *tsp_create_context() {
+    return calloc(1, sizeof(TspContext));
+}
+
+void tsp_free_context(TspContext *context) {
+    if (context == NULL) return;
+    tsp_free_search(&context->search);
+    tsp_free_problem(&context->problem);
+    free(context->reducedMatrix);
+    free(context);
+}
+
+static bool is_limit_reached(const TspSearch *s, double startTime) {
+    const TspOptions *options = &s->problem->options;
+    if (options->timeLimit > 0 && get_time() - startTime >= options->timeLimit) return true;
+    return options->nodeLimit > 0 && s->stats.counts[STAT_EXPANDED] >= options->nodeLimit;
+}
+
+bool tsp_solve(TspContext *c, const int *edgeMatrix, int n, const TspOptions *options, TspResult *result) {
+    if (n < 1) {
+        result->distance = INT_MAX;
+        result->tour = NULL;
+        result->stopped = false;
+        result->lowerBound = INT_MAX;
+        reset_stats(&result->stats);
+        return false;
+    }
+    bool hasTour = true;
+    if (options->reduceGraph) {
+        if (n > c->matrixCapacity) {
+            free(c->reducedMatrix);
+            allocate_int_array(&c->reducedMatrix, n, n);
+            c->matrixCapacity = n;
+        }
+        memcpy(c->reducedMatrix, edgeMatrix, (size_t) n * n * sizeof(int));
+        edgeMatrix = c->reducedMatrix;
+        GraphReduction reduction;
+        hasTour = reduce_graph(c->reducedMatrix, n, &reduction);
+    }
+    double startTime = get_time();
+    TspProblem *p = &c->problem;
+    TspSearch *s = &c->search;
+    tsp_init_problem(p, edgeMatrix, n, options);
+    tsp_init_search(s, p, 1, 1);
+    bool stopped = false;
+    if (hasTour) {
+        if (options->warmStart) tsp_warm_start(p);
+        tsp_init_path(p, s->path);
+        tsp_push_path(s, s->path);
+        while (tsp_has_work(s) && !stopped) {
+            stopped = is_limit_reached(s, startTime);
+            if (!stopped) tsp_expand(s, LIMIT_POLL_INTERVAL);
+        }
+    }
+    int openBound = stopped ? tsp_get_search_open_bound(s) : INT_MAX;
+    s->stats.seconds[STAT_SEARCH_TIME] = get_time() - startTime;
+    result->distance = p->bestDistance;
+    result->tour = p->bestPath;
+    result->stopped = stopped;
+    result->lowerBound = openBound < p->bestDistance ? openBound : p->bestDistance;
+    result->stats = s->stats;
+    return true;
+}
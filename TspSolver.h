@@ -0,0 +1,60 @@
+#ifndef TRAVELINGSALESMAN_TSPSOLVER_H
+#define TRAVELINGSALESMAN_TSPSOLVER_H
+
+#include <stdbool.h>
+#include "EdgeLayout.h"
+#include "SearchStats.h"
+
+/*
+ * Branch and bound solver of both binaries. Its engine, which the binaries drive directly, is in TspEngine.h.
+ */
+
+enum TspBoundMode {
+    TSP_BOUND_NONE, TSP_BOUND_PARTIAL, TSP_BOUND_MINOUT, TSP_BOUND_AP
+};
+
+typedef struct {
+    enum TspBoundMode boundMode;
+    enum EdgeLayoutKind layout;
+    bool cheapestFirst;
+    bool warmStart;
+    bool symmetryBreaking;
+    // false keeps the dense layouts on the scalar row kernel
+    bool simd;
+    // drops the edges no tour can use from a copy of the matrix, and ends right away if there is no tour at all
+    bool reduceGraph;
+    // drops expanded paths whose unvisited nodes can no longer be closed into a tour, only pays off on sparse graphs
+    bool reachChecks;
+    // searches the subtree below every stacked path on one mutable path
+    bool inPlace;
+    // dominance cache of the searches of a problem, split between them, 0 turns it off
+    int cacheMegabytes;
+    // 0 is unlimited, a stopped search reports the best tour so far and a proven lower bound
+    double timeLimit;
+    long nodeLimit;
+} TspOptions;
+
+/*
+ * Reentrant solver for a stream of instances: a TspContext runs one search per call, and its buffers grow to the
+ * largest instance solved so far and are reused by later calls, so small instances are solved without allocating
+ * per node. Contexts are independent of each other, so every thread may solve with its own.
+ */
+
+typedef struct {
+    // INT_MAX if the instance has no tour, or none was found before a limit
+    int distance;
+    // the n + 1 nodes of the tour from and back to 0, owned by the context and valid until its next call
+    const int *tour;
+    bool stopped;
+    int lowerBound;
+    SearchStats stats;
+} TspResult;
+
+typedef struct TspContext TspContext;
+
+TspContext *tsp_create_context();
+void tsp_free_context(TspContext *context);
+// false for a node count below 1, which leaves result without a tour
+bool tsp_solve(TspContext *context, const int *edgeMatrix, int n, const TspOptions *options, TspResult *result);
+
+#endif //TRAVELINGSALESMAN_TSPSOLVER_H
@@ -1,26 +1,58 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdint.h>
 #include "Util.h"
 
 #define ERR_ALLOCATE_MEM (-2)
 #define MAX_DISTANCE 100
-static unsigned int SEED = 42;
 
-int *get_random_edge_matrix(int nNodes, int populationPercentage) {
+/*
+ * Random instances are counter based: every entry is a SplitMix64 hash of the seed and its position, so any
+ * block of rows can be generated on its own, by any number of threads or ranks, and always comes out the same.
+ * The low half of the hash decides whether the edge exists, the high half draws its weight.
+ */
+static uint64_t mix64(uint64_t z) {
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+int *get_random_edge_matrix(int nNodes, int populationPercentage, int threads) {
+    return get_seeded_edge_matrix(nNodes, populationPercentage, RANDOM_SEED, threads);
+}
+
+int *get_seeded_edge_matrix(int nNodes, int populationPercentage, unsigned int seed, int threads) {
     int *edgeMatrix;
     allocate_int_array(&edgeMatrix, nNodes, nNodes);
-    srand(SEED);
-    for (int row = 0; row < nNodes; row++) {
+    fill_random_rows(edgeMatrix, nNodes, populationPercentage, seed, 0, nNodes, threads);
+    return edgeMatrix;
+}
+
+// writes rows firstRow .. firstRow + rowCount - 1 of the instance drawn from seed to rows
+void fill_random_rows(int *rows, int nNodes, int populationPercentage, unsigned int seed, int firstRow, int rowCount,
+                      int threads) {
+    uint64_t key = mix64(seed);
+#pragma omp parallel for schedule(static) num_threads(threads)
+    for (int r = 0; r < rowCount; r++) {
+        uint64_t counter = (uint64_t) (firstRow + r) * nNodes;
         for (int col = 0; col < nNodes; col++) {
-            if (rand_r(&SEED) % 100 < populationPercentage) {
-                edgeMatrix[row * nNodes + col] = rand_r(&SEED) % MAX_DISTANCE;
-            } else {
-                edgeMatrix[row * nNodes + col] = 0;
-            }
+            uint64_t bits = mix64(key ^ (counter + col));
+            bool exists = (uint32_t) bits % 100 < (uint32_t) populationPercentage;
+            rows[(size_t) r * nNodes + col] = exists ? (int) ((bits >> 32) % MAX_DISTANCE) : 0;
         }
     }
-    return edgeMatrix;
+}
+
+// ignores the diagonal, which the search never reads
+bool is_symmetric_matrix(const int *edgeMatrix, int n) {
+    for (int row = 0; row < n; row++) {
+        for (int col = row + 1; col < n; col++) {
+            if (edgeMatrix[row * n + col] != edgeMatrix[col * n + row]) return false;
+        }
+    }
+    return true;
 }
 
 
@@ -67,7 +99,7 @@ void logt_curr_best_dist(bool verbose, int rank, int totalDist, int currBest) {
 }
 
 void allocate_int_array(int **array, int rows, int columns) {
-    int *a = (int *) malloc(rows * columns * sizeof(int));
+    int *a = (int *) malloc((size_t) rows * columns * sizeof(int));
     if (a == NULL) exit(ERR_ALLOCATE_MEM);
     *array = a;
 }
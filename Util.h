@@ -3,9 +3,38 @@
 
 #include <stdbool.h>
 
+/*
+ * Compile-time log level. LOG_INFO keeps the -verbose messages of the work distribution,
+ * LOG_TRACE additionally the per-node output of the search. Calls above LOG_LEVEL are removed
+ * entirely, so the hot path does not even test the verbose flag.
+ */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_TRACE 2
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(call) call
+#else
+#define LOG_INFO(call) ((void) 0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_TRACE
+#define LOG_TRACE(call) call
+#else
+#define LOG_TRACE(call) ((void) 0)
+#endif
+
+// seed of the instances generated from <nNodes> <%population>
+#define RANDOM_SEED 42u
+
 void allocate_int_array(int **array, int rows, int columns);
 void print_edge_matrix(int **edgeMatrix, int n);
-int *get_random_edge_matrix(int nNodes, int populationPercentage);
+int *get_random_edge_matrix(int nNodes, int populationPercentage, int threads);
+int *get_seeded_edge_matrix(int nNodes, int populationPercentage, unsigned int seed, int threads);
+void fill_random_rows(int *rows, int nNodes, int populationPercentage, unsigned int seed, int firstRow, int rowCount,
+                      int threads);
+bool is_symmetric_matrix(const int *edgeMatrix, int n);
 void log_msg(bool verbose, char *s);
 void log_prune(bool verbose, int newDist, int currBest);
 void log_curr_best_dist(bool verbose, int totalDist, int currBest);